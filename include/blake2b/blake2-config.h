@@ -39,6 +39,14 @@
 #endif
 #endif
 
+#if defined(__AVX512F__) && defined(__AVX512VL__) && defined(HAVE_AVX2)
+#if defined(NO_AVX512)
+#pragma message "Not building with AVX-512 even though there's support"
+#else
+#define HAVE_AVX512VL
+#endif
+#endif
+
 #if defined(__XOP__)
 #define HAVE_XOP
 #endif
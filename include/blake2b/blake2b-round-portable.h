@@ -0,0 +1,105 @@
+#pragma once
+#ifndef __BLAKE2B_ROUND_PORTABLE_H__
+#define __BLAKE2B_ROUND_PORTABLE_H__
+
+/*
+ * Plain C versions of the BLAKE2b and BlaMka rounds in blake2b-round.h, for
+ * the portable (SPONGE_PORTABLE) build. The state is 16 uint64_t in the same
+ * row-major order as the SIMD versions keep in their registers.
+ *
+ * Each step of G is written as a loop over the four columns, and the
+ * diagonalization as a rotation of whole rows, so that the compiler can
+ * vectorize each row into a single register for whatever target it is
+ * building for.
+ */
+
+#include <stdint.h>
+
+static inline uint64_t
+blake2b_portable_rotr64(uint64_t w, unsigned int c) {
+    return (w >> c) | (w << (64 - c));
+}
+
+static inline uint64_t
+blake2b_portable_add(uint64_t x, uint64_t y) {
+    return x + y;
+}
+
+/*
+ * BlaMka's multiplication-hardened addition, x + y + 2 * lsw(x) * lsw(y),
+ * where lsw takes the least significant 32 bits of a word.
+ */
+static inline uint64_t
+blake2b_portable_blamka(uint64_t x, uint64_t y) {
+    return x + y + 2 * (uint64_t) (uint32_t) x * (uint32_t) y;
+}
+
+#define GEN_PORTABLE_G(name, add)                                                  \
+static inline void                                                                 \
+name(uint64_t *row1, uint64_t *row2, uint64_t *row3, uint64_t *row4) {             \
+    for (unsigned int i = 0; i < 4; i++) {                                         \
+        row1[i] = add(row1[i], row2[i]);                                           \
+        row4[i] = blake2b_portable_rotr64(row4[i] ^ row1[i], 32);                  \
+        row3[i] = add(row3[i], row4[i]);                                           \
+        row2[i] = blake2b_portable_rotr64(row2[i] ^ row3[i], 24);                  \
+        row1[i] = add(row1[i], row2[i]);                                           \
+        row4[i] = blake2b_portable_rotr64(row4[i] ^ row1[i], 16);                  \
+        row3[i] = add(row3[i], row4[i]);                                           \
+        row2[i] = blake2b_portable_rotr64(row2[i] ^ row3[i], 63);                  \
+    }                                                                              \
+}
+
+GEN_PORTABLE_G(blake2b_portable_g, blake2b_portable_add)
+GEN_PORTABLE_G(blamka_portable_g, blake2b_portable_blamka)
+
+/*
+ * Rotate a row left by |n| words, so that word i moves to position i - n.
+ */
+static inline void
+blake2b_portable_rotate_row(uint64_t *row, unsigned int n) {
+    uint64_t rotated[4];
+    for (unsigned int i = 0; i < 4; i++) {
+        rotated[i] = row[(i + n) % 4];
+    }
+
+    for (unsigned int i = 0; i < 4; i++) {
+        row[i] = rotated[i];
+    }
+}
+
+static inline void
+blake2b_portable_diagonalize(uint64_t *v) {
+    blake2b_portable_rotate_row(v + 4, 1);
+    blake2b_portable_rotate_row(v + 8, 2);
+    blake2b_portable_rotate_row(v + 12, 3);
+}
+
+static inline void
+blake2b_portable_undiagonalize(uint64_t *v) {
+    blake2b_portable_rotate_row(v + 4, 3);
+    blake2b_portable_rotate_row(v + 8, 2);
+    blake2b_portable_rotate_row(v + 12, 1);
+}
+
+static inline void
+blake2b_portable_round(uint64_t *v) {
+    blake2b_portable_g(v, v + 4, v + 8, v + 12);
+    blake2b_portable_diagonalize(v);
+    blake2b_portable_g(v, v + 4, v + 8, v + 12);
+    blake2b_portable_undiagonalize(v);
+}
+
+/*
+ * As in blake2b-round.h, a BlaMka round is a single G over the columns
+ * followed by a diagonalization that is never undone.
+ */
+static inline void
+blamka_portable_round(uint64_t *v) {
+    blamka_portable_g(v, v + 4, v + 8, v + 12);
+    blake2b_portable_diagonalize(v);
+}
+
+#define BLAKE2B_ROUND(v) blake2b_portable_round(v);
+#define BLAMKA_ROUND(v) blamka_portable_round(v);
+
+#endif
@@ -30,7 +30,10 @@
 
 
 /* Microarchitecture-specific macros */
-#ifdef HAVE_AVX2
+#ifdef HAVE_AVX512VL
+/* AVX-512VL rotates 64-bit lanes in a single instruction */
+#define _mm256_roti_epi64(x, c) _mm256_ror_epi64((x), -(c))
+#elif defined(HAVE_AVX2)
 #define r16_256 _mm256_setr_epi8( 2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9, 18, 19, 20, 21, 22, 23, 16, 17, 26, 27, 28, 29, 30, 31, 24, 25 )
 #define r24_256 _mm256_setr_epi8( 3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10, 19, 20, 21, 22, 23, 16, 17, 18, 27, 28, 29, 30, 31, 24, 25, 26 )
 #define _mm256_roti_epi64(x, c) \
@@ -51,7 +54,7 @@
           : (-(c) == 63) ? _mm_xor_si128(_mm_srli_epi64((x), -(c)), _mm_add_epi64((x), (x)))  \
           : _mm_xor_si128(_mm_srli_epi64((x), -(c)), _mm_slli_epi64((x), 64-(-(c))))
 #    else
-#      define _mm_roti_epi64(r, c) _mm_xor_si128(_mm_srli_epi64( (r), -(c) ),_mm_slli_epi64( (r), 64-(-c) ))
+#      define _mm_roti_epi64(r, c) _mm_xor_si128(_mm_srli_epi64( (r), -(c) ),_mm_slli_epi64( (r), 64-(-(c)) ))
 #    endif
 #  else
 /* ... */
@@ -85,13 +88,96 @@
   row3 = _mm256_permute4x64_epi64(row3, _MM_SHUFFLE(1,0,3,2)); \
   row4 = _mm256_permute4x64_epi64(row4, _MM_SHUFFLE(0,3,2,1)); \
 
-#define BLAKE2B_ROUND(v)                 \
-  G1(v[0], v[1], v[2], v[3]);            \
-  G2(v[0], v[1], v[2], v[3]);            \
+/*
+ * The diagonal step only needs rows 2, 3 and 4 rotated by one, two and three
+ * words relative to row 1, so BLAKE2b's round rotates rows 1, 3 and 4 by
+ * three, one and two words instead. Row 2 is the last row G writes and the
+ * first one it reads, and leaving it in place takes the cross-lane permutes
+ * (3 cycles each on Intel) off the serial dependency chain of the round: the
+ * other rows are final a few instructions before G ends and are needed a few
+ * instructions after the next G starts, which hides the permutes' latency.
+ *
+ * BlaMka keeps the reference's DIAGONALIZE, as it never undoes it and the
+ * resulting order of the state is visible to the sponge.
+ */
+#define DIAGONALIZE_ROW1(row1, row2, row3, row4) \
+  row1 = _mm256_permute4x64_epi64(row1, _MM_SHUFFLE(2,1,0,3)); \
+  row3 = _mm256_permute4x64_epi64(row3, _MM_SHUFFLE(0,3,2,1)); \
+  row4 = _mm256_permute4x64_epi64(row4, _MM_SHUFFLE(1,0,3,2)); \
+
+#define UNDIAGONALIZE_ROW1(row1, row2, row3, row4) \
+  row1 = _mm256_permute4x64_epi64(row1, _MM_SHUFFLE(0,3,2,1)); \
+  row3 = _mm256_permute4x64_epi64(row3, _MM_SHUFFLE(2,1,0,3)); \
+  row4 = _mm256_permute4x64_epi64(row4, _MM_SHUFFLE(1,0,3,2)); \
+
+#define BLAKE2B_ROUND(v)                      \
+  G1(v[0], v[1], v[2], v[3]);                 \
+  G2(v[0], v[1], v[2], v[3]);                 \
+  DIAGONALIZE_ROW1(v[0], v[1], v[2], v[3]);   \
+  G1(v[0], v[1], v[2], v[3]);                 \
+  G2(v[0], v[1], v[2], v[3]);                 \
+  UNDIAGONALIZE_ROW1(v[0], v[1], v[2], v[3]); \
+
+/*
+ * BlaMka, the multiplication-hardened variant of the G function used by the
+ * Lyra2 reference implementation when built with Sponge=1. Additions are
+ * replaced by x + y + 2 * lsw(x) * lsw(y), where lsw takes the least
+ * significant 32 bits of each word. As in the reference, a BlaMka round is a
+ * single pass over the columns followed by a diagonalization that is never
+ * undone, so the state is left permuted between rounds.
+ */
+#define fBlaMka(x, y) \
+  _mm256_add_epi64(_mm256_add_epi64((x), (y)), _mm256_slli_epi64(_mm256_mul_epu32((x), (y)), 1))
+
+#define G1_BLAMKA(row1,row2,row3,row4) \
+  row1 = fBlaMka(row1, row2);          \
+  row4 = _mm256_xor_si256(row4, row1); \
+  row4 = _mm256_roti_epi64(row4, -32); \
+  row3 = fBlaMka(row3, row4);          \
+  row2 = _mm256_xor_si256(row2, row3); \
+  row2 = _mm256_roti_epi64(row2, -24); \
+
+#define G2_BLAMKA(row1,row2,row3,row4) \
+  row1 = fBlaMka(row1, row2);          \
+  row4 = _mm256_xor_si256(row4, row1); \
+  row4 = _mm256_roti_epi64(row4, -16); \
+  row3 = fBlaMka(row3, row4);          \
+  row2 = _mm256_xor_si256(row2, row3); \
+  row2 = _mm256_roti_epi64(row2, -63); \
+
+#define BLAMKA_ROUND(v)                  \
+  G1_BLAMKA(v[0], v[1], v[2], v[3]);     \
+  G2_BLAMKA(v[0], v[1], v[2], v[3]);     \
   DIAGONALIZE(v[0], v[1], v[2], v[3]);   \
-  G1(v[0], v[1], v[2], v[3]);            \
-  G2(v[0], v[1], v[2], v[3]);            \
-  UNDIAGONALIZE(v[0], v[1], v[2], v[3]); \
+
+/*
+ * Four independent states, transposed so that v[i] holds word i of each state
+ * in its four 64-bit lanes. Columns and diagonals are just different choices
+ * of registers, so no (un)diagonalization is needed.
+ */
+#define G_X4(a,b,c,d)                  \
+  a = _mm256_add_epi64(a, b);          \
+  d = _mm256_xor_si256(d, a);          \
+  d = _mm256_roti_epi64(d, -32);       \
+  c = _mm256_add_epi64(c, d);          \
+  b = _mm256_xor_si256(b, c);          \
+  b = _mm256_roti_epi64(b, -24);       \
+  a = _mm256_add_epi64(a, b);          \
+  d = _mm256_xor_si256(d, a);          \
+  d = _mm256_roti_epi64(d, -16);       \
+  c = _mm256_add_epi64(c, d);          \
+  b = _mm256_xor_si256(b, c);          \
+  b = _mm256_roti_epi64(b, -63);       \
+
+#define BLAKE2B_ROUND_X4(v)              \
+  G_X4(v[0], v[4], v[ 8], v[12]);        \
+  G_X4(v[1], v[5], v[ 9], v[13]);        \
+  G_X4(v[2], v[6], v[10], v[14]);        \
+  G_X4(v[3], v[7], v[11], v[15]);        \
+  G_X4(v[0], v[5], v[10], v[15]);        \
+  G_X4(v[1], v[6], v[11], v[12]);        \
+  G_X4(v[2], v[7], v[ 8], v[13]);        \
+  G_X4(v[3], v[4], v[ 9], v[14]);        \
 
 #else
 
@@ -194,6 +280,52 @@
 
 #endif // HAVE_SSSE3
 
+#define fBlaMka(x, y) \
+  _mm_add_epi64(_mm_add_epi64((x), (y)), _mm_slli_epi64(_mm_mul_epu32((x), (y)), 1))
+
+#define G1_BLAMKA(row1l,row2l,row3l,row4l,row1h,row2h,row3h,row4h) \
+  row1l = fBlaMka(row1l, row2l); \
+  row1h = fBlaMka(row1h, row2h); \
+  \
+  row4l = _mm_xor_si128(row4l, row1l); \
+  row4h = _mm_xor_si128(row4h, row1h); \
+  \
+  row4l = _mm_roti_epi64(row4l, -32); \
+  row4h = _mm_roti_epi64(row4h, -32); \
+  \
+  row3l = fBlaMka(row3l, row4l); \
+  row3h = fBlaMka(row3h, row4h); \
+  \
+  row2l = _mm_xor_si128(row2l, row3l); \
+  row2h = _mm_xor_si128(row2h, row3h); \
+  \
+  row2l = _mm_roti_epi64(row2l, -24); \
+  row2h = _mm_roti_epi64(row2h, -24); \
+
+#define G2_BLAMKA(row1l,row2l,row3l,row4l,row1h,row2h,row3h,row4h) \
+  row1l = fBlaMka(row1l, row2l); \
+  row1h = fBlaMka(row1h, row2h); \
+  \
+  row4l = _mm_xor_si128(row4l, row1l); \
+  row4h = _mm_xor_si128(row4h, row1h); \
+  \
+  row4l = _mm_roti_epi64(row4l, -16); \
+  row4h = _mm_roti_epi64(row4h, -16); \
+  \
+  row3l = fBlaMka(row3l, row4l); \
+  row3h = fBlaMka(row3h, row4h); \
+  \
+  row2l = _mm_xor_si128(row2l, row3l); \
+  row2h = _mm_xor_si128(row2h, row3h); \
+  \
+  row2l = _mm_roti_epi64(row2l, -63); \
+  row2h = _mm_roti_epi64(row2h, -63); \
+
+#define BLAMKA_ROUND(v) \
+  G1_BLAMKA(v[0],v[2],v[4],v[6],v[1],v[3],v[5],v[7]); \
+  G2_BLAMKA(v[0],v[2],v[4],v[6],v[1],v[3],v[5],v[7]); \
+  DIAGONALIZE(v[0],v[2],v[4],v[6],v[1],v[3],v[5],v[7]);
+
 #define BLAKE2B_ROUND(v) \
   G1(v[0],v[2],v[4],v[6],v[1],v[3],v[5],v[7]); \
   G2(v[0],v[2],v[4],v[6],v[1],v[3],v[5],v[7]); \
@@ -3,9 +3,174 @@
 #include <stdlib.h>
 #include <stdint.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The _x4 variants derive four independent keys at once, sharing the cost
+ * parameters and key length. On AVX2 builds the four computations are
+ * interleaved into the 64-bit lanes of the vector registers; otherwise they
+ * simply run one after the other.
+ */
+#define LYRA2_X4_LANES 4
+
+/*
+ * The compression function used by the sponge. Lyra2 uses BLAKE2b's by
+ * default; the _with_sponge variants can also use BlaMka, its
+ * multiplication-hardened version, and produce the same results as the
+ * reference implementation built with the matching Sponge= setting.
+ *
+ * The _with_sponge variants also take the number of rounds |rho| of the
+ * reduced-round compression function used to fill and visit the matrix, from 1
+ * to LYRA2_MAX_RHO, or 0 for the build's default (a single round, as in the
+ * reference implementation).
+ */
+enum lyra2_sponge {
+    LYRA2_SPONGE_BLAKE2B,
+    LYRA2_SPONGE_BLAMKA
+};
+
+#define LYRA2_MAX_RHO 3
+
+/*
+ * The length, in 64-bit words, of the blocks of the matrix, which the library
+ * takes from SPONGE_BLOCK_WORDS (BLOCK_WORDS= in the Makefile) at build time.
+ * Programs must be built with the same value as the library.
+ */
+#ifdef SPONGE_BLOCK_WORDS
+#define LYRA2_BLOCK_WORDS SPONGE_BLOCK_WORDS
+#else
+#define LYRA2_BLOCK_WORDS 12
+#endif
+
+/*
+ * The _parallel variants spread the computation of a single key over
+ * |nthreads| threads, each filling and visiting its own slice of R / nthreads
+ * rows of the matrix, and produce the same results as the reference
+ * implementation built with nPARALLEL set to |nthreads| (with only one thread,
+ * that is the regular Lyra2). They return -1 if a slice would have fewer than
+ * three rows. Threads are kept in a pool between calls.
+ */
+#define LYRA2_MAX_THREADS 255
+
+/*
+ * The _interleaved variants derive the keys of |njobs| jobs, each with its
+ * own costs, in the calling thread, by keeping up to |nlanes| of them in
+ * flight and advancing them round-robin one column at a time, so that one
+ * job's cache misses are served while the others compute. Each lane has its
+ * own matrix, sized for the largest job, so memory use grows with |nlanes|;
+ * the best value depends on the machine, and a few lanes are usually enough
+ * to cover the memory latency of matrices that do not fit in the caches.
+ *
+ * The _interleaved_with_ctx variants run one lane per context in |ctx|
+ * (see lyra2_ctx_new below), which must all fit the largest job.
+ *
+ * They only support the default sponge, and return -1 without deriving any
+ * key if |nlanes| is 0 or more than LYRA2_MAX_LANES, or if any job has
+ * invalid costs (including T = 0).
+ */
+#define LYRA2_MAX_LANES 16
+
+/*
+ * The memory backing the matrix of the most recent call to any of the
+ * functions below that allocates one. Builds with HUGEPAGES=1 back matrices
+ * of 2 MiB or more with huge pages when the system has them available,
+ * preferring preallocated hugetlbfs pages over transparent huge pages, and
+ * fall back to the heap otherwise. Matrices of 64 MiB or more that are not on
+ * huge pages get their own anonymous mapping (LYRA2_BACKING_MMAP).
+ *
+ * With LYRA2_BACKING_THP, the kernel was asked for transparent huge pages,
+ * but may have left parts of the matrix on regular pages; the AnonHugePages
+ * lines of /proc/<pid>/smaps show how much of it it actually backed.
+ */
+enum lyra2_backing {
+    LYRA2_BACKING_NONE,
+    LYRA2_BACKING_HEAP,
+    LYRA2_BACKING_HUGETLB,
+    LYRA2_BACKING_THP,
+    LYRA2_BACKING_MMAP
+};
+
+enum lyra2_backing lyra2_matrix_backing(void);
+const char *lyra2_backing_name(enum lyra2_backing backing);
+
+/*
+ * Builds with PREFAULT=1 touch every page of a matrix as soon as it is
+ * allocated, so that the hashing itself takes no page faults on it, and builds
+ * with MLOCK=1 also lock it into memory. lyra2_matrix_locked returns nonzero
+ * if the most recent matrix is locked; locking fails, and the matrix is used
+ * unlocked, past RLIMIT_MEMLOCK.
+ */
+int lyra2_matrix_locked(void);
+
+/*
+ * Builds with NUMA=1 have the kernel place each matrix on the NUMA node of the
+ * thread that allocates it, migrating any pages of recycled memory that were
+ * placed on another node; with the _parallel variants, each thread's slice
+ * then goes on the node that thread runs on. lyra2_matrix_node returns the
+ * node of the most recent matrix, or -1 if it was not placed (including on
+ * kernels without NUMA support). Machines with a single node always report
+ * node 0.
+ */
+int lyra2_matrix_node(void);
+
+/*
+ * A context holds the memory for computing keys with at most |max_R| rows of
+ * |max_C| columns (PHS_NCOLS for the PHS functions), and the _with_ctx
+ * variants reuse it instead of allocating their own for every key. They
+ * return -1 for larger costs. A context can only be used by one thread at a
+ * time. The _with_ctx_sponge variants take the sponge and |rho| as the
+ * _with_sponge ones do.
+ *
+ * lyra2_ctx_new returns NULL if |max_R| or |max_C| is 0, or if the memory
+ * could not be allocated.
+ */
+struct lyra2_ctx;
+struct lyra2_ctx *lyra2_ctx_new(uint32_t max_R, uint32_t max_C);
+void lyra2_ctx_free(struct lyra2_ctx *ctx);
+
 #ifdef USE_PHS_INTERFACE
+#ifndef PHS_NCOLS
 #define PHS_NCOLS 256
+#endif
 int PHS(void *out, size_t outlen, const void *in, size_t inlen, const void *salt, size_t saltlen, unsigned int t_cost, unsigned int m_cost);
+int PHS_with_ctx(struct lyra2_ctx *ctx, void *out, size_t outlen, const void *in, size_t inlen, const void *salt, size_t saltlen, unsigned int t_cost, unsigned int m_cost);
+int PHS_with_ctx_sponge(struct lyra2_ctx *ctx, void *out, size_t outlen, const void *in, size_t inlen, const void *salt, size_t saltlen, unsigned int t_cost, unsigned int m_cost, enum lyra2_sponge sponge, unsigned int rho);
+int PHS_with_sponge(void *out, size_t outlen, const void *in, size_t inlen, const void *salt, size_t saltlen, unsigned int t_cost, unsigned int m_cost, enum lyra2_sponge sponge, unsigned int rho);
+int PHS_parallel(void *out, size_t outlen, const void *in, size_t inlen, const void *salt, size_t saltlen, unsigned int t_cost, unsigned int m_cost, unsigned int nthreads);
+struct PHS_job {
+    void *out;
+    size_t outlen;
+    const void *in;
+    size_t inlen;
+    const void *salt;
+    size_t saltlen;
+    unsigned int t_cost, m_cost;
+};
+int PHS_interleaved(const struct PHS_job *jobs, unsigned int njobs, unsigned int nlanes);
+int PHS_interleaved_with_ctx(struct lyra2_ctx *const ctx[], unsigned int nlanes, const struct PHS_job *jobs, unsigned int njobs);
+int PHS_x4(void *const out[LYRA2_X4_LANES], size_t outlen, const void *const in[LYRA2_X4_LANES], const size_t inlen[LYRA2_X4_LANES], const void *const salt[LYRA2_X4_LANES], const size_t saltlen[LYRA2_X4_LANES], unsigned int t_cost, unsigned int m_cost);
 #else
 int lyra2(char *key, uint32_t keylen, const char *pwd, uint32_t pwdlen, const char *salt, uint32_t saltlen, uint32_t R, uint32_t C, uint32_t T);
+int lyra2_with_ctx(struct lyra2_ctx *ctx, char *key, uint32_t keylen, const char *pwd, uint32_t pwdlen, const char *salt, uint32_t saltlen, uint32_t R, uint32_t C, uint32_t T);
+int lyra2_with_ctx_sponge(struct lyra2_ctx *ctx, char *key, uint32_t keylen, const char *pwd, uint32_t pwdlen, const char *salt, uint32_t saltlen, uint32_t R, uint32_t C, uint32_t T, enum lyra2_sponge sponge, unsigned int rho);
+int lyra2_with_sponge(char *key, uint32_t keylen, const char *pwd, uint32_t pwdlen, const char *salt, uint32_t saltlen, uint32_t R, uint32_t C, uint32_t T, enum lyra2_sponge sponge, unsigned int rho);
+int lyra2_parallel(char *key, uint32_t keylen, const char *pwd, uint32_t pwdlen, const char *salt, uint32_t saltlen, uint32_t R, uint32_t C, uint32_t T, unsigned int nthreads);
+struct lyra2_job {
+    char *key;
+    uint32_t keylen;
+    const char *pwd;
+    uint32_t pwdlen;
+    const char *salt;
+    uint32_t saltlen;
+    uint32_t R, C, T;
+};
+int lyra2_interleaved(const struct lyra2_job *jobs, unsigned int njobs, unsigned int nlanes);
+int lyra2_interleaved_with_ctx(struct lyra2_ctx *const ctx[], unsigned int nlanes, const struct lyra2_job *jobs, unsigned int njobs);
+int lyra2_x4(char *const key[LYRA2_X4_LANES], uint32_t keylen, const char *const pwd[LYRA2_X4_LANES], const uint32_t pwdlen[LYRA2_X4_LANES], const char *const salt[LYRA2_X4_LANES], const uint32_t saltlen[LYRA2_X4_LANES], uint32_t R, uint32_t C, uint32_t T);
+#endif
+
+#ifdef __cplusplus
+}
 #endif
@@ -0,0 +1,173 @@
+#pragma once
+
+/*
+ * C++20 interface to the library, as a class template that fixes the
+ * configuration of Lyra2 at compile time:
+ *
+ *   lyra2::Hasher<256> hasher({64, 64});
+ *   hasher.hash(key, std::as_bytes(std::span(pwd)), std::as_bytes(std::span(salt)));
+ *
+ * Include it instead of lyra2.h, whose C functions it declares in the
+ * lyra2::c namespace, as the namespace cannot share its name with lyra2().
+ *
+ * A Hasher owns a context (see lyra2_ctx_new in lyra2.h) sized for its costs,
+ * so hashing allocates nothing, and can be moved but not copied. Like a
+ * context, it can only be used by one thread at a time.
+ *
+ * The template parameters are checked when the Hasher is instantiated, and
+ * each combination calls a single entry point of the library. The columns
+ * must be PHS_NCOLS when the program is built with USE_PHS_INTERFACE, like
+ * the library, and the block length must match the library's (see
+ * LYRA2_BLOCK_WORDS). Costs are checked when they are constructed, which is
+ * at compile time for constexpr ones.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+namespace lyra2::c {
+#include "lyra2.h"
+}
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <span>
+#include <stdexcept>
+
+namespace lyra2 {
+
+using Sponge = c::lyra2_sponge;
+inline constexpr Sponge blake2b = c::LYRA2_SPONGE_BLAKE2B;
+inline constexpr Sponge blamka = c::LYRA2_SPONGE_BLAMKA;
+
+// The number of rows of the matrix |R| (m_cost), at least 3, and of passes of
+// the wandering phase |T| (t_cost), at least 1.
+class Costs {
+public:
+    // Throws std::invalid_argument for fewer than 3 rows or no passes, so
+    // invalid costs in a constant expression do not compile.
+    constexpr Costs(uint32_t R, uint32_t T) : R_(R), T_(T) {
+        if (R < 3) {
+            throw std::invalid_argument("lyra2::Costs: R must be at least 3");
+        }
+        if (T == 0) {
+            throw std::invalid_argument("lyra2::Costs: T must be at least 1");
+        }
+    }
+
+    constexpr uint32_t R() const noexcept {
+        return R_;
+    }
+
+    constexpr uint32_t T() const noexcept {
+        return T_;
+    }
+
+private:
+    uint32_t R_, T_;
+};
+
+template <uint32_t C, unsigned int Rounds = 0, Sponge S = blake2b,
+          unsigned int BlockWords = LYRA2_BLOCK_WORDS>
+class Hasher {
+    static_assert(C > 0, "the matrix needs at least one column");
+#ifdef USE_PHS_INTERFACE
+    static_assert(C == PHS_NCOLS, "the PHS interface only has PHS_NCOLS columns");
+#endif
+    static_assert(Rounds <= LYRA2_MAX_RHO,
+                  "Rounds must be 0 (the default) to LYRA2_MAX_RHO");
+    static_assert(S == blake2b || S == blamka, "unknown sponge");
+    static_assert(BlockWords == LYRA2_BLOCK_WORDS,
+                  "the library was built with a different block length");
+
+public:
+    static constexpr uint32_t columns = C;
+    static constexpr unsigned int rounds = Rounds;
+    static constexpr Sponge sponge = S;
+    static constexpr unsigned int block_words = BlockWords;
+
+    // Throws std::bad_alloc if the matrix could not be allocated.
+    explicit Hasher(Costs costs) : costs_(costs),
+                                   ctx_(c::lyra2_ctx_new(costs.R(), C)) {
+        if (!ctx_) {
+            throw std::bad_alloc();
+        }
+    }
+
+    Hasher(Hasher &&) noexcept = default;
+    Hasher &operator=(Hasher &&) noexcept = default;
+    Hasher(const Hasher &) = delete;
+    Hasher &operator=(const Hasher &) = delete;
+
+    Costs costs() const noexcept {
+        return costs_;
+    }
+
+    // Derive |out.size()| bytes of key from |pwd| and |salt|. Throws
+    // std::length_error if any of them is 4 GiB or longer, as the lengths are
+    // hashed as 32-bit integers, and std::logic_error on a hasher that was
+    // moved from, which no longer has a context.
+    void hash(std::span<std::byte> out, std::span<const std::byte> pwd,
+              std::span<const std::byte> salt) {
+        if (!ctx_) {
+            throw std::logic_error("lyra2::Hasher::hash: moved-from hasher");
+        }
+
+        constexpr size_t max_length = std::numeric_limits<uint32_t>::max();
+        if (out.size() > max_length || pwd.size() > max_length ||
+            salt.size() > max_length) {
+            throw std::length_error("lyra2::Hasher::hash");
+        }
+
+        if (call(out, pwd, salt)) {
+            throw std::runtime_error("lyra2::Hasher::hash");
+        }
+    }
+
+private:
+    int call(std::span<std::byte> out, std::span<const std::byte> pwd,
+             std::span<const std::byte> salt) {
+        const uint32_t R = costs_.R(), T = costs_.T();
+        // the default sponge has its own entry points, which lyra2() also
+        // specializes on the number of columns
+        constexpr bool default_sponge = S == blake2b && Rounds == 0;
+#ifdef USE_PHS_INTERFACE
+        if constexpr (default_sponge) {
+            return c::PHS_with_ctx(ctx_.get(), out.data(), out.size(),
+                                   pwd.data(), pwd.size(), salt.data(),
+                                   salt.size(), T, R);
+        } else {
+            return c::PHS_with_ctx_sponge(ctx_.get(), out.data(), out.size(),
+                                          pwd.data(), pwd.size(), salt.data(),
+                                          salt.size(), T, R, S, Rounds);
+        }
+#else
+        char *key = reinterpret_cast<char *>(out.data());
+        const char *pwd_chars = reinterpret_cast<const char *>(pwd.data());
+        const char *salt_chars = reinterpret_cast<const char *>(salt.data());
+        if constexpr (default_sponge) {
+            return c::lyra2_with_ctx(ctx_.get(), key, out.size(), pwd_chars,
+                                     pwd.size(), salt_chars, salt.size(), R, C,
+                                     T);
+        } else {
+            return c::lyra2_with_ctx_sponge(ctx_.get(), key, out.size(),
+                                            pwd_chars, pwd.size(), salt_chars,
+                                            salt.size(), R, C, T, S, Rounds);
+        }
+#endif
+    }
+
+    struct ctx_deleter {
+        void operator()(c::lyra2_ctx *ctx) const noexcept {
+            c::lyra2_ctx_free(ctx);
+        }
+    };
+
+    Costs costs_;
+    std::unique_ptr<c::lyra2_ctx, ctx_deleter> ctx_;
+};
+
+} // namespace lyra2
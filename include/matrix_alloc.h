@@ -0,0 +1,52 @@
+#pragma once
+
+/*
+ * Allocation of the memory matrix of the Lyra2 functions.
+ *
+ * By default the matrix comes from the heap, except for matrices of at least
+ * LYRA2_MMAP_THRESHOLD bytes, which get their own anonymous mapping: those
+ * may be many GiB large, and are better returned to the system as soon as
+ * they are freed than kept in the heap. Builds with LYRA2_HUGEPAGES map
+ * matrices of at least LYRA2_HUGEPAGE_SIZE bytes straight from the kernel
+ * instead, backed by huge pages so that the wandering phase's random accesses
+ * need fewer TLB entries: preallocated (hugetlbfs) pages if there are any
+ * free, otherwise transparent huge pages. Either falls back to the next, and
+ * ultimately to the heap.
+ *
+ * With LYRA2_PREFAULT, all pages of a new matrix are faulted in before it is
+ * returned, and with LYRA2_MLOCK, it is also locked into memory. With
+ * LYRA2_NUMA, its pages are placed on the allocating thread's NUMA node first.
+ */
+
+#include <stddef.h>
+
+#include "lyra2.h"
+
+#ifndef LYRA2_MMAP_THRESHOLD
+#define LYRA2_MMAP_THRESHOLD (64 * 1024 * 1024)
+#endif
+
+#ifndef LYRA2_HUGEPAGE_SIZE
+#define LYRA2_HUGEPAGE_SIZE (2 * 1024 * 1024)
+#endif
+
+/*
+ * Allocate |size| bytes aligned to |alignment| bytes, a power of two no
+ * larger than the page size, and store the memory backing them in |backing|.
+ *
+ * Returns NULL if no memory could be allocated.
+ */
+void *lyra2_matrix_alloc(size_t size, size_t alignment,
+                         enum lyra2_backing *backing);
+
+/*
+ * With LYRA2_NUMA, place the pages of |size| bytes at |ptr| on the calling
+ * thread's NUMA node, as lyra2_matrix_alloc does for the whole matrix. Pages
+ * only partly within the range are left alone.
+ *
+ * Returns the node, or -1 without LYRA2_NUMA or NUMA support in the kernel.
+ */
+int lyra2_matrix_bind_local(void *ptr, size_t size);
+
+// Free memory returned by lyra2_matrix_alloc with the same |size|.
+void lyra2_matrix_free(void *ptr, size_t size, enum lyra2_backing backing);
@@ -9,28 +9,70 @@
  *
  *   static sponge_t *sponge_new(void)
  *   static void sponge_destroy(sponge_t *sponge)
- * Create and destroy sponge instances.
+ * Create and destroy sponge instances. sponge_new returns NULL if the memory
+ * could not be allocated.
+ *
+ *   static void sponge_reset(sponge_t *sponge)
+ * Put |sponge| back into the state of a newly created instance, so that it can
+ * be reused for another message.
+ *
+ *   static sponge_t *sponge_clone(const sponge_t *sponge)
+ * Create a new sponge instance in the same state as |sponge|, or return NULL
+ * if the memory could not be allocated.
+ *
+ *   static void sponge_snapshot(const sponge_t *sponge,
+ *       sponge_snapshot_t *snapshot);
+ *   static void sponge_restore(sponge_t *sponge,
+ *       const sponge_snapshot_t *snapshot);
+ * Save the state of |sponge| into |snapshot|, or put it back into a sponge.
+ * Snapshots are plain values that can be kept anywhere, so a sponge that has
+ * absorbed a common prefix can be saved once and restored before absorbing
+ * each different suffix, skipping the compressions on the prefix.
  *
  *   void sponge_absorb(sponge_t *sponge, sponge_word_t *data,
  *       size_t databytes, int flags);
  * Absorb the data in the buffer given by |data|, which is of length |databytes|
  * in bytes.
  *
+ *   static void sponge_absorb_init(sponge_absorber_t *absorber,
+ *       sponge_t *sponge, int flags);
+ *   static void sponge_absorb_update(sponge_absorber_t *absorber,
+ *       const void *data, size_t databytes);
+ *   static void sponge_absorb_final(sponge_absorber_t *absorber);
+ * Absorb a message given in any number of pieces, which is equivalent to
+ * calling sponge_absorb on their concatenation. Unlike sponge_absorb, the data
+ * needn't be aligned, is never written to and is padded internally, so it can
+ * come straight from the caller's buffers; only the last partial block of the
+ * message is copied, into |absorber|. The flags are as for sponge_absorb,
+ * except for SPONGE_FLAG_ASSUME_PADDING, which is ignored. |sponge| must not
+ * be used by anything else between the init and final calls.
+ *
  *   static void sponge_squeeze(sponge_t *sponge, sponge_word_t *out,
  *       size_t outbytes, int flags);
  *   static void sponge_squeeze_unaligned(sponge_t *sponge, sponge_word_t *out,
  *       size_t outbytes, int flags);
  * Squeeze |outbytes| bytes out of the sponge and into the buffer pointed to by
- * |out|.
+ * |out|. sponge_squeeze only writes whole sponge words, so |outbytes| must be
+ * a multiple of sizeof(sponge_word_t); sponge_squeeze_unaligned takes any
+ * length.
  *
  *   static void sponge_reduced_extended_duplexing(sponge_t *sponge,
  *       const sponge_word_t inblock[static SPONGE_EXTENDED_RATE_LENGTH],
- *       sponge_word_t outblock[static SPONGE_EXTENDED_RATE_LENGTH]);
+ *       sponge_word_t outblock[static SPONGE_EXTENDED_RATE_LENGTH],
+ *       int flags);
  * Duplex |inblock|, which is assumed to be of size
  * SPONGE_EXTENDED_RATE_SIZE_BYTES, leaving the result in |outblock|. As its
  * name (cryptically) implies, this will always use the extended rate and
- * reduced-round compression function. See the flags section below for an
- * explanation of these terms.
+ * reduced-round compression function, so SPONGE_FLAG_BLAMKA is the only flag
+ * it looks at. See the flags section below for an explanation of these terms.
+ *
+ *   GEN_SPONGE_ROW_DUPLEXING(name, column, ...)
+ * Generate a function
+ *   static void name(sponge_t *sponge, unsigned int ncols, ...);
+ * which runs the statements in |column| for each |col| from 0 to |ncols| - 1.
+ * The statements should duplex with the sponge |row_sponge|, a copy of
+ * |sponge| local to the function which is written back to it at the end. The
+ * remaining macro arguments are the function's extra parameters.
  *
  * Aside from the in/out sponge_word_t data parameters and their respective
  * lengths in bytes, most of these functions also accept a |flags| parameter,
@@ -52,27 +94,72 @@
  * - SPONGE_FLAG_REDUCED: if OR-ed into the flags, the sponge will apply a
  *   faster reduced-round compression function to its internal state instead of
  *   the normal full-round compression function. This flag only alters the
- *   behavior of sponge_absorb and sponge_squeeze{,unaligned}.
+ *   behavior of sponge_absorb and sponge_squeeze{,unaligned}. The reduced-round
+ *   function has SPONGE_REDUCED_ROUNDS rounds, unless SPONGE_FLAG_RHO(rho) is
+ *   also OR-ed into the flags, which selects one with |rho| rounds, for |rho|
+ *   between 1 and SPONGE_MAX_RHO.
+ * - SPONGE_FLAG_BLAMKA: if OR-ed into the flags, the sponge will use the
+ *   multiplication-hardened BlaMka round instead of BLAKE2b's as its
+ *   compression function. BlaMka rounds leave the state in a permuted order,
+ *   so a sponge must be given this flag in either all or none of its calls.
+ *   The multi-buffer sponge below only supports BLAKE2b.
  *
  * Except for sponge_squeeze_unaligned, all of the sponge_* functions assume
  * that its sponge_word_t (or const sponge_word_t *) parameters are aligned to
  * a SPONGE_MEM_ALIGNMENT-byte boundary.
  *
+ * When building with AVX2, a multi-buffer sponge_x4_t is also available. It
+ * holds four independent sponges transposed into the four 64-bit lanes of its
+ * state words, so that state word i contains word i of each sponge:
+ *
+ *   static sponge_x4_t *sponge_x4_new(void)
+ *   static void sponge_x4_destroy(sponge_x4_t *sponge)
+ * Create and destroy multi-buffer sponge instances. sponge_x4_new returns NULL
+ * if the memory could not be allocated.
+ *
+ *   static void sponge_x4_set_lane(sponge_x4_t *sponge, unsigned int lane,
+ *       const sponge_t *src);
+ *   static void sponge_x4_get_lane(const sponge_x4_t *sponge,
+ *       unsigned int lane, sponge_t *dst);
+ * Copy the state of a regular sponge into or out of one of the lanes.
+ *
+ *   static void sponge_x4_reduced_extended_squeeze(sponge_x4_t *sponge,
+ *       sponge_word_t *const outblock[static SPONGE_X4_LANES]);
+ *   static void sponge_x4_reduced_extended_duplexing(sponge_x4_t *sponge,
+ *       const sponge_word_t *const inblock[static SPONGE_X4_LANES],
+ *       sponge_word_t *const outblock[static SPONGE_X4_LANES]);
+ * Same as sponge_squeeze (with the reduced and extended rate flags) and
+ * sponge_reduced_extended_duplexing, one block per lane. The blocks are in the
+ * regular (non-transposed) layout, and |inblock| and |outblock| may alias.
+ *
  * All other symbols in this file which are not mentioned in the above
  * description are to be considered implementation details.
  */
 
 #include "static_assert.h"
+#ifdef SPONGE_PORTABLE
+#include "blake2b/blake2b-round-portable.h"
+#else
 #include "blake2b/blake2b-round.h"
+#endif
 
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#ifndef SPONGE_PORTABLE
 #include <immintrin.h>
+#endif
 #include <assert.h>
 #include <string.h>
 
-#ifdef HAVE_AVX2
+/*
+ * Building with SPONGE_PORTABLE replaces the SSE and AVX2 intrinsics with
+ * plain uint64_t code, leaving vectorization to the compiler.
+ */
+#if defined(SPONGE_PORTABLE)
+typedef uint64_t sponge_word_t;
+#define SPONGE_MEM_ALIGNMENT 8
+#elif defined(HAVE_AVX2)
 typedef __m256i sponge_word_t;
 #define SPONGE_MEM_ALIGNMENT 32
 #else
@@ -80,6 +167,18 @@ typedef __m128i sponge_word_t;
 #define SPONGE_MEM_ALIGNMENT 16
 #endif
 
+/*
+ * Allocate and free memory aligned to SPONGE_MEM_ALIGNMENT bytes, which
+ * malloc already guarantees for the portable build.
+ */
+#ifdef SPONGE_PORTABLE
+#define sponge_aligned_malloc(size) malloc(size)
+#define sponge_aligned_free(ptr) free(ptr)
+#else
+#define sponge_aligned_malloc(size) _mm_malloc((size), SPONGE_MEM_ALIGNMENT)
+#define sponge_aligned_free(ptr) _mm_free(ptr)
+#endif
+
 #define SPONGE_STATE_SIZE_BYTES ((size_t) 128)
 
 STATIC_ASSERT(SPONGE_STATE_SIZE_BYTES % sizeof(sponge_word_t) == 0, sponge_word_divides_state_size);
@@ -89,29 +188,117 @@ STATIC_ASSERT(SPONGE_STATE_LENGTH % 2 == 0, state_length_is_even);
 #define SPONGE_RATE_LENGTH (SPONGE_STATE_LENGTH / 2)
 #define SPONGE_RATE_SIZE_BYTES (SPONGE_RATE_LENGTH * sizeof(sponge_word_t))
 
-#define SPONGE_EXTENDED_RATE_SIZE_BYTES 96
+/*
+ * Length, in 64-bit words, of the blocks duplexed with the extended rate,
+ * which are also the blocks of Lyra2's memory matrix. Like the reference
+ * implementation's bSponge, it can be 8, 10 or 12 at build time.
+ */
+#ifndef SPONGE_BLOCK_WORDS
+#define SPONGE_BLOCK_WORDS 12
+#endif
+
+#if SPONGE_BLOCK_WORDS != 8 && SPONGE_BLOCK_WORDS != 10 && SPONGE_BLOCK_WORDS != 12
+#error "SPONGE_BLOCK_WORDS must be 8, 10 or 12"
+#endif
+
+#if defined(HAVE_AVX2) && SPONGE_BLOCK_WORDS == 10
+#error "10-word blocks are not a whole number of AVX2 words, build with NO_AVX2"
+#endif
+
+#define SPONGE_EXTENDED_RATE_SIZE_BYTES (SPONGE_BLOCK_WORDS * sizeof(uint64_t))
 STATIC_ASSERT(SPONGE_EXTENDED_RATE_SIZE_BYTES % sizeof(sponge_word_t) == 0, sponge_word_divides_extended_rate);
 #define SPONGE_EXTENDED_RATE_LENGTH (SPONGE_EXTENDED_RATE_SIZE_BYTES / sizeof(sponge_word_t))
 
 #define SPONGE_FLAG_EXTENDED_RATE  (1 << 0)
 #define SPONGE_FLAG_ASSUME_PADDING (1 << 1)
 #define SPONGE_FLAG_REDUCED        (1 << 2)
+#define SPONGE_FLAG_BLAMKA         (1 << 3)
+#define SPONGE_FLAG_RHO(rho)       ((rho) << 4)
+#define SPONGE_FLAGS_GET_RHO(flags) (((flags) >> 4) & 3)
+#define SPONGE_MAX_RHO 3
+
+/*
+ * Number of rounds in the full-round and reduced-round compression functions.
+ * Both can be overridden at build time with integer literals up to 16, and
+ * get their own fully unrolled compression functions.
+ */
+#ifndef SPONGE_FULL_ROUNDS
+#define SPONGE_FULL_ROUNDS 12
+#endif
+
+#ifndef SPONGE_REDUCED_ROUNDS
+#define SPONGE_REDUCED_ROUNDS 1
+#endif
 
 typedef struct sponge_s sponge_t;
+typedef struct sponge_absorber_s sponge_absorber_t;
+typedef struct sponge_snapshot_s sponge_snapshot_t;
 
 static sponge_t *sponge_new(void);
 static void sponge_destroy(sponge_t *sponge);
+static void sponge_reset(sponge_t *sponge);
+static sponge_t *sponge_clone(const sponge_t *sponge);
+static void sponge_snapshot(const sponge_t *sponge, sponge_snapshot_t *snapshot);
+static void sponge_restore(sponge_t *sponge, const sponge_snapshot_t *snapshot);
 static void sponge_absorb(sponge_t *sponge, sponge_word_t *data, size_t databytes, int flags);
+static void sponge_absorb_init(sponge_absorber_t *absorber, sponge_t *sponge, int flags);
+static void sponge_absorb_update(sponge_absorber_t *absorber, const void *data, size_t databytes);
+static void sponge_absorb_final(sponge_absorber_t *absorber);
 static void sponge_squeeze(sponge_t *sponge, sponge_word_t *out, size_t outbytes, int flags);
 static void sponge_squeeze_unaligned(sponge_t *sponge, sponge_word_t *out, size_t outbytes, int flags);
-static void sponge_reduced_extended_duplexing(sponge_t *sponge, const sponge_word_t inblock[static SPONGE_EXTENDED_RATE_LENGTH], sponge_word_t outblock[static SPONGE_EXTENDED_RATE_LENGTH]);
+static void sponge_reduced_extended_duplexing(sponge_t *sponge, const sponge_word_t inblock[static SPONGE_EXTENDED_RATE_LENGTH], sponge_word_t outblock[static SPONGE_EXTENDED_RATE_LENGTH], int flags);
 
 #if defined(_MSC_VER)
 #define ALIGN(x) __declspec(align(x))
+#define ALWAYS_INLINE __forceinline
 #else
 #define ALIGN(x) __attribute__ ((__aligned__(x)))
+#define ALWAYS_INLINE inline __attribute__ ((__always_inline__))
 #endif
 
+#define SPONGE_REPEAT_1(x) x
+#define SPONGE_REPEAT_2(x) SPONGE_REPEAT_1(x) x
+#define SPONGE_REPEAT_3(x) SPONGE_REPEAT_2(x) x
+#define SPONGE_REPEAT_4(x) SPONGE_REPEAT_3(x) x
+#define SPONGE_REPEAT_5(x) SPONGE_REPEAT_4(x) x
+#define SPONGE_REPEAT_6(x) SPONGE_REPEAT_5(x) x
+#define SPONGE_REPEAT_7(x) SPONGE_REPEAT_6(x) x
+#define SPONGE_REPEAT_8(x) SPONGE_REPEAT_7(x) x
+#define SPONGE_REPEAT_9(x) SPONGE_REPEAT_8(x) x
+#define SPONGE_REPEAT_10(x) SPONGE_REPEAT_9(x) x
+#define SPONGE_REPEAT_11(x) SPONGE_REPEAT_10(x) x
+#define SPONGE_REPEAT_12(x) SPONGE_REPEAT_11(x) x
+#define SPONGE_REPEAT_13(x) SPONGE_REPEAT_12(x) x
+#define SPONGE_REPEAT_14(x) SPONGE_REPEAT_13(x) x
+#define SPONGE_REPEAT_15(x) SPONGE_REPEAT_14(x) x
+#define SPONGE_REPEAT_16(x) SPONGE_REPEAT_15(x) x
+#define SPONGE_REPEAT_(n, x) SPONGE_REPEAT_##n(x)
+#define SPONGE_REPEAT(n, x) SPONGE_REPEAT_(n, x)
+
+/*
+ * Generate an unrolled compression function applying |nrounds| rounds of
+ * |round| to the state |v|.
+ */
+#define GEN_SPONGE_COMPRESS(name, type, round, nrounds) \
+static inline void                                      \
+name(type *v) {                                         \
+    SPONGE_REPEAT(nrounds, round(v))                    \
+}
+
+// a BlaMka round is only half of a BLAKE2b round (see BLAMKA_ROUND)
+#define BLAMKA_DOUBLE_ROUND(v) BLAMKA_ROUND(v) BLAMKA_ROUND(v)
+
+GEN_SPONGE_COMPRESS(sponge_compress_blake2b_full, sponge_word_t, BLAKE2B_ROUND, SPONGE_FULL_ROUNDS)
+GEN_SPONGE_COMPRESS(sponge_compress_blake2b_reduced, sponge_word_t, BLAKE2B_ROUND, SPONGE_REDUCED_ROUNDS)
+GEN_SPONGE_COMPRESS(sponge_compress_blake2b_rho1, sponge_word_t, BLAKE2B_ROUND, 1)
+GEN_SPONGE_COMPRESS(sponge_compress_blake2b_rho2, sponge_word_t, BLAKE2B_ROUND, 2)
+GEN_SPONGE_COMPRESS(sponge_compress_blake2b_rho3, sponge_word_t, BLAKE2B_ROUND, 3)
+GEN_SPONGE_COMPRESS(sponge_compress_blamka_full, sponge_word_t, BLAMKA_DOUBLE_ROUND, SPONGE_FULL_ROUNDS)
+GEN_SPONGE_COMPRESS(sponge_compress_blamka_reduced, sponge_word_t, BLAMKA_ROUND, SPONGE_REDUCED_ROUNDS)
+GEN_SPONGE_COMPRESS(sponge_compress_blamka_rho1, sponge_word_t, BLAMKA_ROUND, 1)
+GEN_SPONGE_COMPRESS(sponge_compress_blamka_rho2, sponge_word_t, BLAMKA_ROUND, 2)
+GEN_SPONGE_COMPRESS(sponge_compress_blamka_rho3, sponge_word_t, BLAMKA_ROUND, 3)
+
 ALIGN(SPONGE_MEM_ALIGNMENT)
 static const uint64_t sponge_blake2b_IV[16] = {
     0x0000000000000000ULL, 0x0000000000000000ULL,
@@ -129,22 +316,55 @@ struct sponge_s {
 };
 
 static inline void sponge_pad(uint8_t *data, size_t *databytes);
-static inline void sponge_compress(sponge_t *sponge, bool reduced);
+static inline void sponge_compress(sponge_t *sponge, int flags);
 
 static sponge_t *
 sponge_new(void) {
-    sponge_t *sponge = _mm_malloc(sizeof(sponge_t), SPONGE_MEM_ALIGNMENT);
+    sponge_t *sponge = sponge_aligned_malloc(sizeof(sponge_t));
+    if (sponge) {
+        sponge_reset(sponge);
+    }
+    return sponge;
+}
+
+static void
+sponge_reset(sponge_t *sponge) {
     const size_t step = sizeof(sponge_word_t) / sizeof(uint64_t);
     for (unsigned int i = 0; i < SPONGE_STATE_LENGTH; i++) {
         sponge->state[i] = *((sponge_word_t *) (sponge_blake2b_IV + step*i));
     }
-
-    return sponge;
 }
 
 static void
 sponge_destroy(sponge_t *sponge) {
-    _mm_free(sponge);
+    sponge_aligned_free(sponge);
+}
+
+struct sponge_snapshot_s {
+  sponge_word_t state[SPONGE_STATE_LENGTH];
+};
+
+static inline sponge_t *
+sponge_clone(const sponge_t *sponge) {
+    sponge_t *clone = sponge_aligned_malloc(sizeof(sponge_t));
+    if (clone) {
+        *clone = *sponge;
+    }
+    return clone;
+}
+
+static inline void
+sponge_snapshot(const sponge_t *sponge, sponge_snapshot_t *snapshot) {
+    for (unsigned int i = 0; i < SPONGE_STATE_LENGTH; i++) {
+        snapshot->state[i] = sponge->state[i];
+    }
+}
+
+static inline void
+sponge_restore(sponge_t *sponge, const sponge_snapshot_t *snapshot) {
+    for (unsigned int i = 0; i < SPONGE_STATE_LENGTH; i++) {
+        sponge->state[i] = snapshot->state[i];
+    }
 }
 
 static inline void
@@ -166,7 +386,7 @@ sponge_absorb(sponge_t *sponge, sponge_word_t *data, size_t databytes, int flags
             sponge->state[i] ^= data[i];
         }
 
-        sponge_compress(sponge, !!(flags & SPONGE_FLAG_REDUCED));
+        sponge_compress(sponge, flags);
         data += rate;
         datalenw -= rate;
     }
@@ -174,21 +394,103 @@ sponge_absorb(sponge_t *sponge, sponge_word_t *data, size_t databytes, int flags
     return;
 }
 
+struct sponge_absorber_s {
+  // the pending partial block, at most one (extended) rate long
+  uint8_t block[SPONGE_EXTENDED_RATE_SIZE_BYTES];
+  size_t blockbytes;
+  size_t ratebytes;
+  sponge_t *sponge;
+  int flags;
+};
+
+static inline void
+sponge_absorb_unaligned_block(sponge_t *sponge, const uint8_t *data,
+                              size_t ratebytes, int flags) {
+    for (unsigned int i = 0; i < ratebytes / sizeof(sponge_word_t); i++) {
+        sponge_word_t word;
+        memcpy(&word, data + i * sizeof(sponge_word_t), sizeof(word));
+        sponge->state[i] ^= word;
+    }
+
+    sponge_compress(sponge, flags);
+}
+
+static inline void
+sponge_absorb_init(sponge_absorber_t *absorber, sponge_t *sponge, int flags) {
+    absorber->blockbytes = 0;
+    absorber->ratebytes = SPONGE_RATE_SIZE_BYTES;
+    if (flags & SPONGE_FLAG_EXTENDED_RATE) {
+        absorber->ratebytes = SPONGE_EXTENDED_RATE_SIZE_BYTES;
+    }
+
+    absorber->sponge = sponge;
+    absorber->flags = flags;
+}
+
+static inline void
+sponge_absorb_update(sponge_absorber_t *absorber, const void *data, size_t databytes) {
+    const uint8_t *bytes = data;
+    const size_t ratebytes = absorber->ratebytes;
+
+    if (absorber->blockbytes) {
+        size_t fill = ratebytes - absorber->blockbytes;
+        if (fill > databytes) {
+            fill = databytes;
+        }
+
+        memcpy(absorber->block + absorber->blockbytes, bytes, fill);
+        absorber->blockbytes += fill;
+        bytes += fill;
+        databytes -= fill;
+
+        if (absorber->blockbytes < ratebytes) {
+            return;
+        }
+
+        sponge_absorb_unaligned_block(absorber->sponge, absorber->block,
+                                      ratebytes, absorber->flags);
+        absorber->blockbytes = 0;
+    }
+
+    while (databytes >= ratebytes) {
+        sponge_absorb_unaligned_block(absorber->sponge, bytes, ratebytes,
+                                      absorber->flags);
+        bytes += ratebytes;
+        databytes -= ratebytes;
+    }
+
+    memcpy(absorber->block, bytes, databytes);
+    absorber->blockbytes = databytes;
+}
+
+static inline void
+sponge_absorb_final(sponge_absorber_t *absorber) {
+    // 10*1 padding, as in sponge_pad, but to the rate in use
+    const size_t ratebytes = absorber->ratebytes;
+    absorber->block[absorber->blockbytes] = 0x80;
+    memset(absorber->block + absorber->blockbytes + 1, 0,
+           ratebytes - absorber->blockbytes - 1);
+    absorber->block[ratebytes - 1] |= 0x01;
+
+    sponge_absorb_unaligned_block(absorber->sponge, absorber->block,
+                                  ratebytes, absorber->flags);
+    absorber->blockbytes = 0;
+}
+
 #define SPONGE_SQUEEZE_BODY                                                \
     size_t outlenw = outbytes / sizeof(sponge_word_t);                     \
                                                                            \
     while (outlenw >= SPONGE_EXTENDED_RATE_LENGTH) {                       \
         COPY_SPONGE_WORDS(out, sponge->state, SPONGE_EXTENDED_RATE_LENGTH) \
                                                                            \
-        sponge_compress(sponge, !!(flags & SPONGE_FLAG_REDUCED));          \
+        sponge_compress(sponge, flags);                                    \
         out += SPONGE_EXTENDED_RATE_LENGTH;                                \
         outlenw -= SPONGE_EXTENDED_RATE_LENGTH;                            \
     }                                                                      \
                                                                            \
-    COPY_SPONGE_WORDS(out, sponge->state, outlenw)                         \
-    return;
+    COPY_SPONGE_WORDS(out, sponge->state, outlenw)
 
-static inline void
+static ALWAYS_INLINE void
 sponge_squeeze(sponge_t *sponge, sponge_word_t *out, size_t outbytes, int flags) {
 #define COPY_SPONGE_WORDS(dst, src, nwords)      \
     for (unsigned int i = 0; i < nwords; i++) {  \
@@ -204,19 +506,25 @@ sponge_squeeze_unaligned(sponge_t *sponge, sponge_word_t *out, size_t outbytes,
     memcpy(dst, src, nwords * sizeof(sponge_word_t));
     SPONGE_SQUEEZE_BODY
 #undef COPY_SPONGE_WORDS
+
+    // as in the reference implementation, the output may end in the middle
+    // of a word, which is as wide as 32 bytes with AVX2
+    memcpy(out + outlenw, sponge->state + outlenw,
+           outbytes % sizeof(sponge_word_t));
 }
 
-static inline void
+static ALWAYS_INLINE void
 sponge_reduced_extended_duplexing(sponge_t *sponge,
         const sponge_word_t inblock[static SPONGE_EXTENDED_RATE_LENGTH],
-        sponge_word_t outblock[static SPONGE_EXTENDED_RATE_LENGTH]) {
+        sponge_word_t outblock[static SPONGE_EXTENDED_RATE_LENGTH],
+        int flags) {
     // Lyra2 always duplexes single blocks of SPONGE_RATE_SIZE_BYTES bytes,
     // and doesn't pad them.
     for (unsigned int i = 0; i < SPONGE_EXTENDED_RATE_LENGTH; i++) {
         sponge->state[i] ^= inblock[i];
     }
 
-    sponge_compress(sponge, true);
+    sponge_compress(sponge, SPONGE_FLAG_REDUCED | flags);
 
     for (unsigned int i = 0; i < SPONGE_EXTENDED_RATE_LENGTH; i++) {
         outblock[i] = sponge->state[i];
@@ -225,6 +533,22 @@ sponge_reduced_extended_duplexing(sponge_t *sponge,
     return;
 }
 
+/*
+ * The copy of the state made by row duplexing functions never escapes, so the
+ * compiler can keep it in registers for the whole row. Duplexing with |sponge|
+ * directly reloads and stores the state around every block, as the blocks
+ * written in between could alias it.
+ */
+#define GEN_SPONGE_ROW_DUPLEXING(name, column, ...)       \
+static ALWAYS_INLINE void                                 \
+name(sponge_t *sponge, unsigned int ncols, __VA_ARGS__) { \
+    sponge_t row_sponge = *sponge;                        \
+    for (unsigned int col = 0; col < ncols; col++) {      \
+        column                                            \
+    }                                                     \
+    *sponge = row_sponge;                                 \
+}
+
 /**
  * Append 10*1 padding to a chunk of data so its size is a multiple
  * of SPONGE_RATE_SIZE_BYTES.
@@ -248,22 +572,152 @@ sponge_pad(uint8_t *data, size_t *databytes) {
     return;
 }
 
+static ALWAYS_INLINE void
+sponge_compress(sponge_t *sponge, int flags) {
+#define SPONGE_COMPRESS_VARIANT(variant)                  \
+    if (flags & SPONGE_FLAG_BLAMKA) {                     \
+        sponge_compress_blamka_##variant(sponge->state);  \
+    } else {                                              \
+        sponge_compress_blake2b_##variant(sponge->state); \
+    }                                                     \
+    return;
+
+    if (!(flags & SPONGE_FLAG_REDUCED)) {
+        SPONGE_COMPRESS_VARIANT(full)
+    }
+
+    switch (SPONGE_FLAGS_GET_RHO(flags)) {
+    case 1:
+        SPONGE_COMPRESS_VARIANT(rho1)
+    case 2:
+        SPONGE_COMPRESS_VARIANT(rho2)
+    case 3:
+        SPONGE_COMPRESS_VARIANT(rho3)
+    default:
+        SPONGE_COMPRESS_VARIANT(reduced)
+    }
+#undef SPONGE_COMPRESS_VARIANT
+}
+
+#ifdef HAVE_AVX2
+#define SPONGE_X4_LANES 4
+#define SPONGE_X4_STATE_LENGTH (SPONGE_STATE_SIZE_BYTES / sizeof(uint64_t))
+
+typedef struct sponge_x4_s sponge_x4_t;
+
+struct sponge_x4_s {
+  __m256i state[SPONGE_X4_STATE_LENGTH];
+};
+
+static inline void sponge_x4_compress(sponge_x4_t *sponge, bool reduced);
+
+static sponge_x4_t *
+sponge_x4_new(void) {
+    sponge_x4_t *sponge = _mm_malloc(sizeof(sponge_x4_t), SPONGE_MEM_ALIGNMENT);
+    if (sponge) {
+        for (unsigned int i = 0; i < SPONGE_X4_STATE_LENGTH; i++) {
+            sponge->state[i] = _mm256_set1_epi64x(sponge_blake2b_IV[i]);
+        }
+    }
+
+    return sponge;
+}
+
+static void
+sponge_x4_destroy(sponge_x4_t *sponge) {
+    _mm_free(sponge);
+}
+
+static inline void
+sponge_x4_set_lane(sponge_x4_t *sponge, unsigned int lane, const sponge_t *src) {
+    // go through memcpy, as the states are only ever accessed as vectors
+    uint64_t words[SPONGE_X4_STATE_LENGTH], lanes[SPONGE_X4_STATE_LENGTH][SPONGE_X4_LANES];
+    memcpy(words, src->state, sizeof(words));
+    memcpy(lanes, sponge->state, sizeof(lanes));
+    for (unsigned int i = 0; i < SPONGE_X4_STATE_LENGTH; i++) {
+        lanes[i][lane] = words[i];
+    }
+    memcpy(sponge->state, lanes, sizeof(lanes));
+}
+
+static inline void
+sponge_x4_get_lane(const sponge_x4_t *sponge, unsigned int lane, sponge_t *dst) {
+    uint64_t words[SPONGE_X4_STATE_LENGTH], lanes[SPONGE_X4_STATE_LENGTH][SPONGE_X4_LANES];
+    memcpy(lanes, sponge->state, sizeof(lanes));
+    for (unsigned int i = 0; i < SPONGE_X4_STATE_LENGTH; i++) {
+        words[i] = lanes[i][lane];
+    }
+    memcpy(dst->state, words, sizeof(words));
+}
+
+/*
+ * Transpose four words of four lanes, so that lane i of word j ends up in lane
+ * j of word i. This is its own inverse.
+ */
+static inline void
+sponge_x4_transpose(__m256i *w0, __m256i *w1, __m256i *w2, __m256i *w3) {
+    __m256i t0 = _mm256_unpacklo_epi64(*w0, *w1);
+    __m256i t1 = _mm256_unpackhi_epi64(*w0, *w1);
+    __m256i t2 = _mm256_unpacklo_epi64(*w2, *w3);
+    __m256i t3 = _mm256_unpackhi_epi64(*w2, *w3);
+    *w0 = _mm256_permute2x128_si256(t0, t2, 0x20);
+    *w1 = _mm256_permute2x128_si256(t1, t3, 0x20);
+    *w2 = _mm256_permute2x128_si256(t0, t2, 0x31);
+    *w3 = _mm256_permute2x128_si256(t1, t3, 0x31);
+}
+
+static inline void
+sponge_x4_store_rate(const sponge_x4_t *sponge,
+        sponge_word_t *const outblock[static SPONGE_X4_LANES]) {
+    for (unsigned int i = 0; i < SPONGE_EXTENDED_RATE_LENGTH; i++) {
+        __m256i w0 = sponge->state[4*i], w1 = sponge->state[4*i + 1];
+        __m256i w2 = sponge->state[4*i + 2], w3 = sponge->state[4*i + 3];
+        sponge_x4_transpose(&w0, &w1, &w2, &w3);
+        outblock[0][i] = w0;
+        outblock[1][i] = w1;
+        outblock[2][i] = w2;
+        outblock[3][i] = w3;
+    }
+}
+
+static inline void
+sponge_x4_reduced_extended_squeeze(sponge_x4_t *sponge,
+        sponge_word_t *const outblock[static SPONGE_X4_LANES]) {
+    sponge_x4_store_rate(sponge, outblock);
+    sponge_x4_compress(sponge, true);
+    return;
+}
+
 static inline void
-sponge_compress(sponge_t *sponge, bool reduced) {
-    BLAKE2B_ROUND(sponge->state)
-    if (!reduced) {
-        BLAKE2B_ROUND(sponge->state)
-        BLAKE2B_ROUND(sponge->state)
-        BLAKE2B_ROUND(sponge->state)
-        BLAKE2B_ROUND(sponge->state)
-        BLAKE2B_ROUND(sponge->state)
-        BLAKE2B_ROUND(sponge->state)
-        BLAKE2B_ROUND(sponge->state)
-        BLAKE2B_ROUND(sponge->state)
-        BLAKE2B_ROUND(sponge->state)
-        BLAKE2B_ROUND(sponge->state)
-        BLAKE2B_ROUND(sponge->state)
+sponge_x4_reduced_extended_duplexing(sponge_x4_t *sponge,
+        const sponge_word_t *const inblock[static SPONGE_X4_LANES],
+        sponge_word_t *const outblock[static SPONGE_X4_LANES]) {
+    for (unsigned int i = 0; i < SPONGE_EXTENDED_RATE_LENGTH; i++) {
+        __m256i w0 = inblock[0][i], w1 = inblock[1][i];
+        __m256i w2 = inblock[2][i], w3 = inblock[3][i];
+        sponge_x4_transpose(&w0, &w1, &w2, &w3);
+        sponge->state[4*i] ^= w0;
+        sponge->state[4*i + 1] ^= w1;
+        sponge->state[4*i + 2] ^= w2;
+        sponge->state[4*i + 3] ^= w3;
+    }
+
+    sponge_x4_compress(sponge, true);
+    sponge_x4_store_rate(sponge, outblock);
+    return;
+}
+
+GEN_SPONGE_COMPRESS(sponge_x4_compress_full, __m256i, BLAKE2B_ROUND_X4, SPONGE_FULL_ROUNDS)
+GEN_SPONGE_COMPRESS(sponge_x4_compress_reduced, __m256i, BLAKE2B_ROUND_X4, SPONGE_REDUCED_ROUNDS)
+
+static ALWAYS_INLINE void
+sponge_x4_compress(sponge_x4_t *sponge, bool reduced) {
+    if (reduced) {
+        sponge_x4_compress_reduced(sponge->state);
+    } else {
+        sponge_x4_compress_full(sponge->state);
     }
 
     return;
 }
+#endif // HAVE_AVX2
@@ -0,0 +1,83 @@
+#pragma once
+
+/*
+ * A persistent pool of worker threads for the parallel Lyra2 functions, along
+ * with the spinning synchronization primitives their threads use while
+ * working on a shared matrix.
+ *
+ * The workers are created the first time they are needed and then wait on a
+ * condition variable between jobs, so each hash only pays for waking them up.
+ * Inside a job, threads never block in the kernel: they spin on a shared
+ * counter for a short while, and only then yield the processor.
+ */
+
+#include <stdint.h>
+
+typedef void (*lyra2_pool_fn)(void *arg, unsigned int thread);
+
+/*
+ * Run fn(arg, thread) for every thread in [0, nthreads), with thread 0 on the
+ * calling thread and the others on pool workers, returning once all of them
+ * are done. Jobs submitted concurrently from different threads run one after
+ * the other.
+ *
+ * Returns 0, or -1 if the pool could not create enough workers.
+ */
+int lyra2_pool_run(unsigned int nthreads, lyra2_pool_fn fn, void *arg);
+
+// Give up the processor while waiting for other threads to catch up.
+void lyra2_pool_yield(void);
+
+#ifndef LYRA2_POOL_SPINS
+#define LYRA2_POOL_SPINS 4096
+#endif
+
+/*
+ * Wait until *counter, which other threads only ever increase, reaches
+ * |value|. Writes made by the thread that stored |value| are visible once
+ * this returns.
+ */
+static inline void
+lyra2_pool_wait_geq(const uint64_t *counter, uint64_t value) {
+    for (unsigned int spins = 0;
+         __atomic_load_n(counter, __ATOMIC_ACQUIRE) < value; spins++) {
+        if (spins < LYRA2_POOL_SPINS) {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+        } else {
+            lyra2_pool_yield();
+        }
+    }
+}
+
+/*
+ * A centralized barrier: the last thread to arrive resets the count and
+ * starts a new generation, which releases the others.
+ */
+struct lyra2_barrier {
+    unsigned int nthreads;
+    unsigned int arrived;
+    uint64_t generation;
+};
+
+static inline void
+lyra2_barrier_init(struct lyra2_barrier *barrier, unsigned int nthreads) {
+    barrier->nthreads = nthreads;
+    barrier->arrived = 0;
+    barrier->generation = 0;
+}
+
+static inline void
+lyra2_barrier_wait(struct lyra2_barrier *barrier) {
+    // the generation cannot change until this thread arrives
+    uint64_t generation = __atomic_load_n(&barrier->generation, __ATOMIC_ACQUIRE);
+
+    if (__atomic_add_fetch(&barrier->arrived, 1, __ATOMIC_ACQ_REL) == barrier->nthreads) {
+        __atomic_store_n(&barrier->arrived, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&barrier->generation, generation + 1, __ATOMIC_RELEASE);
+        return;
+    }
+
+    lyra2_pool_wait_geq(&barrier->generation, generation + 1);
+}
@@ -51,10 +51,73 @@ def build(builds):
 AVAILABLE_BUILDS = {
     "lyra2-clang": "make CC=clang NO_AVX2=1",
     "lyra2-gcc": "make CC=gcc NO_AVX2=1",
-    "lyra2-avx2-clang": "make CC=clang",
-    "lyra2-avx2-gcc": "make CC=gcc",
+    "lyra2-avx2-clang": "make CC=clang NO_AVX512=1",
+    "lyra2-avx2-gcc": "make CC=gcc NO_AVX512=1",
+    "lyra2-avx512-clang": "make CC=clang",
+    "lyra2-avx512-gcc": "make CC=gcc",
+    "lyra2-avx2-x4-clang": "make CC=clang BENCH_X4=1",
+    "lyra2-avx2-x4-gcc": "make CC=gcc BENCH_X4=1",
+    "lyra2-dispatch-clang": "make CC=clang DISPATCH=1",
+    "lyra2-dispatch-gcc": "make CC=gcc DISPATCH=1",
+    "lyra2-dispatch-sse2-gcc": "make CC=gcc DISPATCH=1",
+    "lyra2-dispatch-ssse3-gcc": "make CC=gcc DISPATCH=1",
+    "lyra2-dispatch-avx2-gcc": "make CC=gcc DISPATCH=1",
+    "lyra2-dispatch-avx512-gcc": "make CC=gcc DISPATCH=1",
+    "lyra2-blamka-clang": "make CC=clang NO_AVX2=1 BENCH_BLAMKA=1",
+    "lyra2-blamka-gcc": "make CC=gcc NO_AVX2=1 BENCH_BLAMKA=1",
+    "lyra2-avx2-blamka-clang": "make CC=clang BENCH_BLAMKA=1",
+    "lyra2-avx2-blamka-gcc": "make CC=gcc BENCH_BLAMKA=1",
+    "lyra2-rho2-gcc": "make CC=gcc NO_AVX2=1 BENCH_RHO=2",
+    "lyra2-rho3-gcc": "make CC=gcc NO_AVX2=1 BENCH_RHO=3",
+    "lyra2-avx2-rho2-gcc": "make CC=gcc BENCH_RHO=2",
+    "lyra2-avx2-rho3-gcc": "make CC=gcc BENCH_RHO=3",
+    "lyra2-b8-gcc": "make CC=gcc NO_AVX2=1 BLOCK_WORDS=8",
+    "lyra2-b10-gcc": "make CC=gcc BLOCK_WORDS=10",
+    "lyra2-avx2-b8-gcc": "make CC=gcc BLOCK_WORDS=8",
+    "lyra2-portable-clang": "make CC=clang PORTABLE=1",
+    "lyra2-portable-gcc": "make CC=gcc PORTABLE=1",
+    "lyra2-prefetch-gcc": "make CC=gcc NO_AVX2=1 PREFETCH=1",
+    "lyra2-avx2-prefetch-gcc": "make CC=gcc PREFETCH=1",
+    "lyra2-reversed-gcc": "make CC=gcc NO_AVX2=1 REVERSED_ROWS=1",
+    "lyra2-avx2-reversed-gcc": "make CC=gcc REVERSED_ROWS=1",
+    "lyra2-hugepages-gcc": "make CC=gcc NO_AVX2=1 HUGEPAGES=1",
+    "lyra2-avx2-hugepages-gcc": "make CC=gcc HUGEPAGES=1",
+    "lyra2-ctx-gcc": "make CC=gcc NO_AVX2=1 BENCH_CTX=1",
+    "lyra2-avx2-ctx-gcc": "make CC=gcc BENCH_CTX=1",
+    "lyra2-ctx-prefault-gcc": "make CC=gcc NO_AVX2=1 BENCH_CTX=1 PREFAULT=1",
+    "lyra2-ctx-mlock-gcc": "make CC=gcc NO_AVX2=1 BENCH_CTX=1 PREFAULT=1 MLOCK=1",
+    "lyra2-numa-gcc": "make CC=gcc NO_AVX2=1 NUMA=1",
+    "lyra2-large-gcc": "make CC=gcc NO_AVX2=1 BENCH_LARGE=1",
+    "lyra2-t2-gcc": "make CC=gcc NO_AVX2=1 BENCH_THREADS=2",
+    "lyra2-t4-gcc": "make CC=gcc NO_AVX2=1 BENCH_THREADS=4",
+    "lyra2-avx2-t4-gcc": "make CC=gcc BENCH_THREADS=4",
+    "lyra2-interleave2-gcc": "make CC=gcc BENCH_INTERLEAVE=2",
+    "lyra2-interleave4-gcc": "make CC=gcc BENCH_INTERLEAVE=4",
+    "lyra2-interleave8-gcc": "make CC=gcc BENCH_INTERLEAVE=8",
     "ref-clang": "make bench-ref CC=clang",
-    "ref-gcc": "make bench-ref CC=gcc"
+    "ref-gcc": "make bench-ref CC=gcc",
+    "ref-b8-gcc": "make bench-ref CC=gcc BLOCK_WORDS=8",
+    "ref-b10-gcc": "make bench-ref CC=gcc BLOCK_WORDS=10",
+    "ref-blamka-clang": "make bench-ref CC=clang BENCH_BLAMKA=1",
+    "ref-blamka-gcc": "make bench-ref CC=gcc BENCH_BLAMKA=1"
+}
+
+# Builds with padded and unpadded row strides for a range of column counts,
+# to be compared at the same count, e.g. lyra2-c512-pad64-gcc lyra2-c512-gcc.
+for ncols in (64, 128, 256, 512, 1024):
+    base = "make CC=gcc NCOLS=%d" % ncols
+    AVAILABLE_BUILDS["lyra2-c%d-gcc" % ncols] = base
+    AVAILABLE_BUILDS["ref-c%d-gcc" % ncols] = base.replace("make", "make bench-ref")
+    for pad in (64, 128, 192):
+        AVAILABLE_BUILDS["lyra2-c%d-pad%d-gcc" % (ncols, pad)] = \
+            "%s ROW_PAD=%d" % (base, pad)
+
+# Extra environment variables to run some of the builds with
+BUILD_ENVIRONMENTS = {
+    "lyra2-dispatch-sse2-gcc": {"LYRA2_FORCE_ISA": "sse2"},
+    "lyra2-dispatch-ssse3-gcc": {"LYRA2_FORCE_ISA": "ssse3"},
+    "lyra2-dispatch-avx2-gcc": {"LYRA2_FORCE_ISA": "avx2"},
+    "lyra2-dispatch-avx512-gcc": {"LYRA2_FORCE_ISA": "avx512"}
 }
 
 if len(sys.argv) == 1:
@@ -88,9 +151,10 @@ if None in build_commands:
 
 binaries = build(zip(build_names, build_commands))
 outputs = []
-for binary in binaries:
+for name, binary in zip(build_names, binaries):
+    env = dict(os.environ, **BUILD_ENVIRONMENTS.get(name, {}))
     outputs.append(
-        subprocess.check_output([binary])[:-1].split("\n"))
+        subprocess.check_output([binary], env = env)[:-1].split("\n"))
 shutil.rmtree(BINARIES_DIR)
 
 for o in outputs:
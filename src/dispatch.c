@@ -0,0 +1,307 @@
+/*
+ * Runtime instruction set selection for the DISPATCH build.
+ *
+ * In that build, src/lyra2.c is compiled once per supported ISA level with
+ * LYRA2_ISA set to the level's name, which suffixes its public functions (so
+ * PHS becomes PHS_avx2, and so on). The functions in this file take the place
+ * of the unsuffixed ones and forward each call to the fastest copy the CPU
+ * can run, as reported by cpuid.
+ *
+ * Setting the LYRA2_FORCE_ISA environment variable to one of the level names
+ * below selects that copy instead, which allows comparing the different code
+ * paths on a single machine.
+ *
+ * All copies are built with LYRA2_ROT_BITS=128, so they compute the same
+ * hashes regardless of the one that ends up selected (test/lyra2_test.check
+ * compares them).
+ */
+
+#include "lyra2.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#ifdef USE_PHS_INTERFACE
+#define DECLARE_ISA(isa)                                                 \
+    __typeof__(lyra2_ctx_new) lyra2_ctx_new_##isa;                       \
+    __typeof__(lyra2_ctx_free) lyra2_ctx_free_##isa;                     \
+    __typeof__(PHS) PHS_##isa;                                           \
+    __typeof__(PHS_with_ctx) PHS_with_ctx_##isa;                         \
+    __typeof__(PHS_with_ctx_sponge) PHS_with_ctx_sponge_##isa;           \
+    __typeof__(PHS_with_sponge) PHS_with_sponge_##isa;                   \
+    __typeof__(PHS_parallel) PHS_parallel_##isa;                         \
+    __typeof__(PHS_interleaved) PHS_interleaved_##isa;                   \
+    __typeof__(PHS_interleaved_with_ctx) PHS_interleaved_with_ctx_##isa; \
+    __typeof__(PHS_x4) PHS_x4_##isa;
+#define ISA_FUNCTIONS(isa) lyra2_ctx_new_##isa, lyra2_ctx_free_##isa, PHS_##isa, \
+    PHS_with_ctx_##isa, PHS_with_ctx_sponge_##isa, PHS_with_sponge_##isa,        \
+    PHS_parallel_##isa, PHS_interleaved_##isa, PHS_interleaved_with_ctx_##isa,   \
+    PHS_x4_##isa
+#else
+#define DECLARE_ISA(isa)                                                     \
+    __typeof__(lyra2_ctx_new) lyra2_ctx_new_##isa;                           \
+    __typeof__(lyra2_ctx_free) lyra2_ctx_free_##isa;                         \
+    __typeof__(lyra2) lyra2_##isa;                                           \
+    __typeof__(lyra2_with_ctx) lyra2_with_ctx_##isa;                         \
+    __typeof__(lyra2_with_ctx_sponge) lyra2_with_ctx_sponge_##isa;           \
+    __typeof__(lyra2_with_sponge) lyra2_with_sponge_##isa;                   \
+    __typeof__(lyra2_parallel) lyra2_parallel_##isa;                         \
+    __typeof__(lyra2_interleaved) lyra2_interleaved_##isa;                   \
+    __typeof__(lyra2_interleaved_with_ctx) lyra2_interleaved_with_ctx_##isa; \
+    __typeof__(lyra2_x4) lyra2_x4_##isa;
+#define ISA_FUNCTIONS(isa) lyra2_ctx_new_##isa, lyra2_ctx_free_##isa,       \
+    lyra2_##isa, lyra2_with_ctx_##isa, lyra2_with_ctx_sponge_##isa,         \
+    lyra2_with_sponge_##isa, lyra2_parallel_##isa, lyra2_interleaved_##isa, \
+    lyra2_interleaved_with_ctx_##isa, lyra2_x4_##isa
+#endif
+
+DECLARE_ISA(sse2)
+DECLARE_ISA(ssse3)
+DECLARE_ISA(avx2)
+DECLARE_ISA(avx512)
+
+static bool
+isa_sse2_supported(void) {
+    return __builtin_cpu_supports("sse2");
+}
+
+static bool
+isa_ssse3_supported(void) {
+    return __builtin_cpu_supports("ssse3") && __builtin_cpu_supports("sse4.1");
+}
+
+static bool
+isa_avx2_supported(void) {
+    return __builtin_cpu_supports("avx2");
+}
+
+static bool
+isa_avx512_supported(void) {
+    return isa_avx2_supported() && __builtin_cpu_supports("avx512f") &&
+        __builtin_cpu_supports("avx512vl");
+}
+
+struct lyra2_isa {
+    const char *name;
+    bool (*supported)(void);
+    __typeof__(lyra2_ctx_new) *lyra2_ctx_new;
+    __typeof__(lyra2_ctx_free) *lyra2_ctx_free;
+#ifdef USE_PHS_INTERFACE
+    __typeof__(PHS) *phs;
+    __typeof__(PHS_with_ctx) *phs_with_ctx;
+    __typeof__(PHS_with_ctx_sponge) *phs_with_ctx_sponge;
+    __typeof__(PHS_with_sponge) *phs_with_sponge;
+    __typeof__(PHS_parallel) *phs_parallel;
+    __typeof__(PHS_interleaved) *phs_interleaved;
+    __typeof__(PHS_interleaved_with_ctx) *phs_interleaved_with_ctx;
+    __typeof__(PHS_x4) *phs_x4;
+#else
+    __typeof__(lyra2) *lyra2;
+    __typeof__(lyra2_with_ctx) *lyra2_with_ctx;
+    __typeof__(lyra2_with_ctx_sponge) *lyra2_with_ctx_sponge;
+    __typeof__(lyra2_with_sponge) *lyra2_with_sponge;
+    __typeof__(lyra2_parallel) *lyra2_parallel;
+    __typeof__(lyra2_interleaved) *lyra2_interleaved;
+    __typeof__(lyra2_interleaved_with_ctx) *lyra2_interleaved_with_ctx;
+    __typeof__(lyra2_x4) *lyra2_x4;
+#endif
+};
+
+// in order of preference
+static const struct lyra2_isa isas[] = {
+    { "avx512", isa_avx512_supported, ISA_FUNCTIONS(avx512) },
+    { "avx2", isa_avx2_supported, ISA_FUNCTIONS(avx2) },
+    { "ssse3", isa_ssse3_supported, ISA_FUNCTIONS(ssse3) },
+    { "sse2", isa_sse2_supported, ISA_FUNCTIONS(sse2) },
+};
+
+static const struct lyra2_isa *
+select_isa(void) {
+    // Concurrent first calls may all run the selection, but they will all
+    // reach the same result. The release store pairs with the acquire load,
+    // so a thread that sees the pointer also sees the entry it points to.
+    static const struct lyra2_isa *selected = NULL;
+    const struct lyra2_isa *isa = __atomic_load_n(&selected, __ATOMIC_ACQUIRE);
+    if (isa) {
+        return isa;
+    }
+
+    __builtin_cpu_init();
+
+    const char *forced = getenv("LYRA2_FORCE_ISA");
+    if (forced && !*forced) {
+        forced = NULL;
+    }
+
+    const struct lyra2_isa *best = NULL;
+    for (unsigned int i = 0; i < sizeof(isas) / sizeof(isas[0]); i++) {
+        if (!isas[i].supported()) {
+            continue;
+        }
+
+        if (!best) {
+            best = &isas[i];
+        }
+
+        if (forced && !strcmp(forced, isas[i].name)) {
+            isa = &isas[i];
+            break;
+        }
+    }
+
+    // SSE2 is part of x86-64, so there is always a supported ISA
+    if (!isa) {
+        if (forced) {
+            fprintf(stderr, "LYRA2_FORCE_ISA: '%s' is unknown or unsupported, "
+                    "using '%s'\n", forced, best->name);
+        }
+
+        isa = best;
+    }
+
+    __atomic_store_n(&selected, isa, __ATOMIC_RELEASE);
+    return isa;
+}
+
+// Contexts are only ever used with the copy that created them, since the
+// selection never changes once made.
+struct lyra2_ctx *
+lyra2_ctx_new(uint32_t max_R, uint32_t max_C) {
+    return select_isa()->lyra2_ctx_new(max_R, max_C);
+}
+
+void
+lyra2_ctx_free(struct lyra2_ctx *ctx) {
+    select_isa()->lyra2_ctx_free(ctx);
+}
+
+#ifdef USE_PHS_INTERFACE
+int
+PHS(void *out, size_t outlen, const void *in, size_t inlen, const void *salt,
+    size_t saltlen, unsigned int t_cost, unsigned int m_cost) {
+    return select_isa()->phs(out, outlen, in, inlen, salt, saltlen,
+                             t_cost, m_cost);
+}
+
+int
+PHS_with_ctx(struct lyra2_ctx *ctx, void *out, size_t outlen, const void *in,
+             size_t inlen, const void *salt, size_t saltlen,
+             unsigned int t_cost, unsigned int m_cost) {
+    return select_isa()->phs_with_ctx(ctx, out, outlen, in, inlen, salt,
+                                      saltlen, t_cost, m_cost);
+}
+
+int
+PHS_with_ctx_sponge(struct lyra2_ctx *ctx, void *out, size_t outlen,
+                    const void *in, size_t inlen, const void *salt,
+                    size_t saltlen, unsigned int t_cost, unsigned int m_cost,
+                    enum lyra2_sponge sponge, unsigned int rho) {
+    return select_isa()->phs_with_ctx_sponge(ctx, out, outlen, in, inlen, salt,
+                                             saltlen, t_cost, m_cost, sponge,
+                                             rho);
+}
+
+int
+PHS_with_sponge(void *out, size_t outlen, const void *in, size_t inlen,
+                const void *salt, size_t saltlen, unsigned int t_cost,
+                unsigned int m_cost, enum lyra2_sponge sponge,
+                unsigned int rho) {
+    return select_isa()->phs_with_sponge(out, outlen, in, inlen, salt, saltlen,
+                                         t_cost, m_cost, sponge, rho);
+}
+
+int
+PHS_parallel(void *out, size_t outlen, const void *in, size_t inlen,
+             const void *salt, size_t saltlen, unsigned int t_cost,
+             unsigned int m_cost, unsigned int nthreads) {
+    return select_isa()->phs_parallel(out, outlen, in, inlen, salt, saltlen,
+                                      t_cost, m_cost, nthreads);
+}
+
+int
+PHS_interleaved(const struct PHS_job *jobs, unsigned int njobs,
+                unsigned int nlanes) {
+    return select_isa()->phs_interleaved(jobs, njobs, nlanes);
+}
+
+int
+PHS_interleaved_with_ctx(struct lyra2_ctx *const ctx[], unsigned int nlanes,
+                         const struct PHS_job *jobs, unsigned int njobs) {
+    return select_isa()->phs_interleaved_with_ctx(ctx, nlanes, jobs, njobs);
+}
+
+int
+PHS_x4(void *const out[LYRA2_X4_LANES], size_t outlen,
+       const void *const in[LYRA2_X4_LANES], const size_t inlen[LYRA2_X4_LANES],
+       const void *const salt[LYRA2_X4_LANES], const size_t saltlen[LYRA2_X4_LANES],
+       unsigned int t_cost, unsigned int m_cost) {
+    return select_isa()->phs_x4(out, outlen, in, inlen, salt, saltlen,
+                                t_cost, m_cost);
+}
+#else
+int
+lyra2(char *key, uint32_t keylen, const char *pwd, uint32_t pwdlen,
+      const char *salt, uint32_t saltlen, uint32_t R, uint32_t C,
+      uint32_t T) {
+    return select_isa()->lyra2(key, keylen, pwd, pwdlen, salt, saltlen,
+                               R, C, T);
+}
+
+int
+lyra2_with_ctx(struct lyra2_ctx *ctx, char *key, uint32_t keylen,
+               const char *pwd, uint32_t pwdlen, const char *salt,
+               uint32_t saltlen, uint32_t R, uint32_t C, uint32_t T) {
+    return select_isa()->lyra2_with_ctx(ctx, key, keylen, pwd, pwdlen, salt,
+                                        saltlen, R, C, T);
+}
+
+int
+lyra2_with_ctx_sponge(struct lyra2_ctx *ctx, char *key, uint32_t keylen,
+                      const char *pwd, uint32_t pwdlen, const char *salt,
+                      uint32_t saltlen, uint32_t R, uint32_t C, uint32_t T,
+                      enum lyra2_sponge sponge, unsigned int rho) {
+    return select_isa()->lyra2_with_ctx_sponge(ctx, key, keylen, pwd, pwdlen,
+                                               salt, saltlen, R, C, T, sponge,
+                                               rho);
+}
+
+int
+lyra2_with_sponge(char *key, uint32_t keylen, const char *pwd,
+                  uint32_t pwdlen, const char *salt, uint32_t saltlen,
+                  uint32_t R, uint32_t C, uint32_t T,
+                  enum lyra2_sponge sponge, unsigned int rho) {
+    return select_isa()->lyra2_with_sponge(key, keylen, pwd, pwdlen, salt,
+                                           saltlen, R, C, T, sponge, rho);
+}
+
+int
+lyra2_parallel(char *key, uint32_t keylen, const char *pwd, uint32_t pwdlen,
+               const char *salt, uint32_t saltlen, uint32_t R, uint32_t C,
+               uint32_t T, unsigned int nthreads) {
+    return select_isa()->lyra2_parallel(key, keylen, pwd, pwdlen, salt,
+                                        saltlen, R, C, T, nthreads);
+}
+
+int
+lyra2_interleaved(const struct lyra2_job *jobs, unsigned int njobs,
+                  unsigned int nlanes) {
+    return select_isa()->lyra2_interleaved(jobs, njobs, nlanes);
+}
+
+int
+lyra2_interleaved_with_ctx(struct lyra2_ctx *const ctx[], unsigned int nlanes,
+                           const struct lyra2_job *jobs, unsigned int njobs) {
+    return select_isa()->lyra2_interleaved_with_ctx(ctx, nlanes, jobs, njobs);
+}
+
+int
+lyra2_x4(char *const key[LYRA2_X4_LANES], uint32_t keylen,
+         const char *const pwd[LYRA2_X4_LANES], const uint32_t pwdlen[LYRA2_X4_LANES],
+         const char *const salt[LYRA2_X4_LANES], const uint32_t saltlen[LYRA2_X4_LANES],
+         uint32_t R, uint32_t C, uint32_t T) {
+    return select_isa()->lyra2_x4(key, keylen, pwd, pwdlen, salt, saltlen,
+                                  R, C, T);
+}
+#endif
@@ -1,10 +1,42 @@
+#ifdef LYRA2_ISA
+/*
+ * This file is being built as one of the per-ISA copies of the library that
+ * src/dispatch.c chooses from at runtime, so suffix its public functions with
+ * the ISA name.
+ */
+#define LYRA2_ISA_NAME_(name, isa) name##_##isa
+#define LYRA2_ISA_NAME(name, isa) LYRA2_ISA_NAME_(name, isa)
+#define lyra2 LYRA2_ISA_NAME(lyra2, LYRA2_ISA)
+#define lyra2_x4 LYRA2_ISA_NAME(lyra2_x4, LYRA2_ISA)
+#define PHS LYRA2_ISA_NAME(PHS, LYRA2_ISA)
+#define PHS_x4 LYRA2_ISA_NAME(PHS_x4, LYRA2_ISA)
+#define lyra2_with_sponge LYRA2_ISA_NAME(lyra2_with_sponge, LYRA2_ISA)
+#define PHS_with_sponge LYRA2_ISA_NAME(PHS_with_sponge, LYRA2_ISA)
+#define lyra2_parallel LYRA2_ISA_NAME(lyra2_parallel, LYRA2_ISA)
+#define PHS_parallel LYRA2_ISA_NAME(PHS_parallel, LYRA2_ISA)
+#define lyra2_ctx_new LYRA2_ISA_NAME(lyra2_ctx_new, LYRA2_ISA)
+#define lyra2_ctx_free LYRA2_ISA_NAME(lyra2_ctx_free, LYRA2_ISA)
+#define lyra2_with_ctx LYRA2_ISA_NAME(lyra2_with_ctx, LYRA2_ISA)
+#define PHS_with_ctx LYRA2_ISA_NAME(PHS_with_ctx, LYRA2_ISA)
+#define lyra2_with_ctx_sponge LYRA2_ISA_NAME(lyra2_with_ctx_sponge, LYRA2_ISA)
+#define PHS_with_ctx_sponge LYRA2_ISA_NAME(PHS_with_ctx_sponge, LYRA2_ISA)
+#define lyra2_interleaved LYRA2_ISA_NAME(lyra2_interleaved, LYRA2_ISA)
+#define PHS_interleaved LYRA2_ISA_NAME(PHS_interleaved, LYRA2_ISA)
+#define lyra2_interleaved_with_ctx LYRA2_ISA_NAME(lyra2_interleaved_with_ctx, LYRA2_ISA)
+#define PHS_interleaved_with_ctx LYRA2_ISA_NAME(PHS_interleaved_with_ctx, LYRA2_ISA)
+#endif
+
 #include "sponge.h"
 #include "lyra2.h"
+#include "matrix_alloc.h"
 #include "static_assert.h"
+#include "threadpool.h"
 
 #include <string.h>
+#include <limits.h>
+#ifndef SPONGE_PORTABLE
 #include <immintrin.h>
-#include <assert.h>
+#endif
 
 #ifdef __WORDSIZE
 #define W (__WORDSIZE)
@@ -28,103 +60,819 @@ block_##name(block_t bdst, const block_t bsrc1, const block_t bsrc2, ##__VA_ARGS
     }                                                                                 \
 }
 
+/*
+ * Block rotations, and the choice of the words used as row and column indices,
+ * work in units of Rt bits. By default Rt is the size of a bword, but building
+ * with LYRA2_ROT_BITS=128 keeps it at 128 bits under AVX2 too, making the
+ * results identical to those of the SSE builds and the reference
+ * implementation. The portable build, whose bwords are single words, uses
+ * 128 bits unless told otherwise for the same reason.
+ */
+#if defined(SPONGE_PORTABLE) && !defined(LYRA2_ROT_BITS)
+#define LYRA2_ROT_BITS 128
+#endif
+
+#ifdef LYRA2_ROT_BITS
+#define rtwords (LYRA2_ROT_BITS / W)
+#else
+#define rtwords (sizeof(bword_t) / sizeof(uint64_t))
+#endif
+STATIC_ASSERT(rtwords > 0 && (sizeof(bword_t) % (rtwords * sizeof(uint64_t)) == 0 ||
+              (rtwords * sizeof(uint64_t)) % sizeof(bword_t) == 0), Rt_and_L_are_multiples);
+#define nrtwords (SPONGE_EXTENDED_RATE_SIZE_BYTES / (rtwords * sizeof(uint64_t)))
+// bwords per Rt-bit unit, for bwords no larger than Rt
+#define rtbwords (rtwords * sizeof(uint64_t) / sizeof(bword_t))
+
 GEN_BLOCK_OPERATION(xor, bdst[i] = bsrc1[i] ^ bsrc2[i])
 GEN_BLOCK_OPERATION(wordwise_add, bdst[i] = bsrc1[i] + bsrc2[i])
+
+#if defined(HAVE_AVX2) && defined(LYRA2_ROT_BITS)
+STATIC_ASSERT(LYRA2_ROT_BITS == 128 || LYRA2_ROT_BITS == 256, Rt_is_128_or_256_bits);
+
+static inline void
+block_xor_rotR(block_t bdst, const block_t bsrc1, const block_t bsrc2, unsigned int rot) {
+    const unsigned int halves = sizeof(bword_t) * CHAR_BIT / LYRA2_ROT_BITS;
+    for (unsigned int i = 0; i < nbwords; i++) {
+        bword_t rotated = bsrc2[(i + rot / halves) % nbwords];
+        if (rot % halves) {
+            // an odd number of 128-bit halves straddles two bwords
+            rotated = _mm256_permute2x128_si256(rotated,
+                bsrc2[(i + rot / halves + 1) % nbwords], 0x21);
+        }
+        bdst[i] = bsrc1[i] ^ rotated;
+    }
+}
+#elif defined(SPONGE_PORTABLE)
+GEN_BLOCK_OPERATION(xor_rotR, bdst[i] = bsrc1[i] ^ bsrc2[(i + rot*rtbwords) % nbwords], unsigned int rot)
+#else
 GEN_BLOCK_OPERATION(xor_rotR, bdst[i] = bsrc1[i] ^ bsrc2[(i+rot) % nbwords], unsigned int rot)
+#endif
 
+#ifdef SPONGE_PORTABLE
 static inline uint64_t
 block_get_lsw_from_bword(const block_t block, unsigned int bwordidx) {
-    return *((uint64_t *) &block[bwordidx % nbwords]);
+    return block[(bwordidx % nrtwords) * rtbwords];
+}
+#else
+/*
+ * Rt is at least 128 bits, so the word we want is always the low word of a
+ * 128-bit lane, and can be moved out of the vector register holding it
+ * without going through memory.
+ */
+static inline uint64_t
+block_get_lsw_from_bword(const block_t block, unsigned int bwordidx) {
+    const unsigned int bword_words = sizeof(bword_t) / sizeof(uint64_t);
+    const unsigned int word = (bwordidx % nrtwords) * rtwords;
+    bword_t bword = block[word / bword_words];
+#ifdef HAVE_AVX2
+    __m128i lane = word % bword_words ?
+        _mm256_extracti128_si256(bword, 1) : _mm256_castsi256_si128(bword);
+#else
+    __m128i lane = bword;
+#endif
+    return _mm_cvtsi128_si64(lane);
+}
+#endif
+
+/*
+ * The memory matrix, as R rows of C blocks laid out |stride| bytes apart. The
+ * stride is padded with LYRA2_ROW_PAD bytes beyond the length of a row: with
+ * the default 256 columns, unpadded rows are a whole number of pages long, so
+ * the blocks at the same column of different rows, which the filling and
+ * wandering phases access together, would alias in the L1 cache and in the
+ * store-to-load forwarding logic.
+ */
+#ifndef LYRA2_ROW_PAD
+#define LYRA2_ROW_PAD 0
+#endif
+STATIC_ASSERT(LYRA2_ROW_PAD % SPONGE_MEM_ALIGNMENT == 0, row_pad_keeps_blocks_aligned);
+
+typedef struct {
+    uint8_t *rows;
+    size_t stride;
+    size_t size;
+    enum lyra2_backing backing;
+} matrix_t;
+
+static inline bool
+matrix_alloc(matrix_t *matrix, uint64_t nrows, uint32_t ncols) {
+    // an empty matrix would leave nothing to hash, and a zero stride below
+    if (nrows == 0 || ncols == 0) {
+        return false;
+    }
+
+#if SIZE_MAX <= UINT32_MAX
+    // only possible with a 32-bit size_t
+    if (ncols > (SIZE_MAX - LYRA2_ROW_PAD) / sizeof(block_t)) {
+        return false;
+    }
+#endif
+
+    matrix->stride = ncols * sizeof(block_t) + LYRA2_ROW_PAD;
+    if (nrows > SIZE_MAX / matrix->stride) {
+        return false;
+    }
+
+    matrix->size = nrows * matrix->stride;
+    matrix->rows = lyra2_matrix_alloc(matrix->size, SPONGE_MEM_ALIGNMENT,
+                                      &matrix->backing);
+    return matrix->rows != NULL;
+}
+
+static inline void
+matrix_free(matrix_t *matrix) {
+    lyra2_matrix_free(matrix->rows, matrix->size, matrix->backing);
+}
+
+static inline block_t *
+matrix_row(matrix_t matrix, uint64_t row) {
+    return (block_t *) (matrix.rows + row * matrix.stride);
+}
+
+/*
+ * The setup and filling phases read their input rows from the first column
+ * to the last, but write each new row from the last column to the first.
+ * Building with LYRA2_REVERSED_ROWS stores every row back to front, which
+ * turns those writes into forward streams at the cost of running the reads
+ * backwards instead: a row is read in the opposite order it is written in,
+ * so no fixed placement of the columns can make both streams forward.
+ *
+ * All accesses to a row go through matrix_col, which maps the column the
+ * algorithm refers to to its position in memory.
+ */
+static inline uint64_t
+matrix_col(uint32_t ncols, uint64_t col) {
+#ifdef LYRA2_REVERSED_ROWS
+    return ncols - 1 - col;
+#else
+    (void) ncols;
+    return col;
+#endif
+}
+
+/*
+ * The wandering phase reduces two words of every duplexed block modulo the
+ * number of columns, and two per row modulo the number of rows. A 64-bit
+ * division takes tens of cycles, a sizable share of a reduced duplexing, so
+ * divisor_mod instead multiplies by a reciprocal computed once per hash
+ * (Lemire, Kaser and Kurz, "Faster Remainder by Direct Computation", 2019):
+ * with a 128-bit reciprocal M = ceil(2^128 / d), x mod d is the top 64 bits
+ * of (M * x mod 2^128) * d for every 64-bit x and 32-bit d. Powers of two,
+ * which include all the column counts lyra2() has specialized instances for,
+ * reduce to a mask instead, and the compiler drops the other path when |d|
+ * is a constant.
+ */
+typedef struct {
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 reciprocal;
+#endif
+    uint32_t d;
+} divisor_t;
+
+static ALWAYS_INLINE divisor_t
+divisor_new(uint32_t d) {
+    divisor_t divisor = { .d = d };
+#ifdef __SIZEOF_INT128__
+    // wraps to 0 for d = 1, for which divisor_mod correctly yields 0 too
+    divisor.reciprocal = ~(unsigned __int128) 0 / d + 1;
+#endif
+    return divisor;
+}
+
+static ALWAYS_INLINE uint64_t
+divisor_mod(uint64_t x, divisor_t divisor) {
+    if ((divisor.d & (divisor.d - 1)) == 0) {
+        return x & (divisor.d - 1);
+    }
+
+#ifdef __SIZEOF_INT128__
+    const unsigned __int128 fraction = divisor.reciprocal * x;
+    const unsigned __int128 lo = (unsigned __int128) (uint64_t) fraction * divisor.d;
+    const unsigned __int128 hi = (unsigned __int128) (uint64_t) (fraction >> 64) * divisor.d;
+    return (hi + (lo >> 64)) >> 64;
+#else
+    return x % divisor.d;
+#endif
 }
 
+/*
+ * Building with LYRA2_PREFETCH has the wandering phase prefetch the blocks it
+ * will read next as soon as their indices are known, instead of leaving the
+ * random accesses to miss once the matrix outgrows the caches. The
+ * interleaved functions always do.
+ */
 static inline void
-write_basil(uint8_t *buf, uint32_t keylen, const char *pwd,
-            uint32_t pwdlen, const char *salt, uint32_t saltlen,
-            uint32_t R, uint32_t C, uint32_t T) {
-#define WRITE_PTR(ptr, size) \
-    memcpy(buf, ptr, size);  \
-    buf += size;
-
-#define WRITE_VALUE(value)              \
-    memcpy(buf, &value, sizeof(value)); \
-    buf += sizeof(value);
-
-    // FIXME: using memcpy assumes little-endian architecture
-
-    WRITE_PTR(pwd, pwdlen)
-    WRITE_PTR(salt, saltlen)
-    WRITE_VALUE(keylen)
-    WRITE_VALUE(pwdlen)
-    WRITE_VALUE(saltlen)
-    WRITE_VALUE(T)
-    WRITE_VALUE(R)
-    WRITE_VALUE(C)
-
-#undef WRITE_PTR
-#undef WRITE_VALUE
+block_prefetch(const block_t block) {
+    // a block spans two cache lines
+    __builtin_prefetch(block, 0, 3);
+    __builtin_prefetch((const char *) block + sizeof(block_t) - 1, 0, 3);
+}
+
+/*
+ * Absorb the basil, pwd || salt || params, straight from the caller's buffers.
+ */
+static inline void
+absorb_basil(sponge_t *sponge, uint32_t keylen, const char *pwd,
+             uint32_t pwdlen, const char *salt, uint32_t saltlen,
+             uint32_t R, uint32_t C, uint32_t T, int sponge_flags) {
+    // FIXME: absorbing the integers in memory order assumes a little-endian
+    // architecture
+    const uint32_t params[] = { keylen, pwdlen, saltlen, T, R, C };
+    sponge_absorber_t absorber;
+
+    sponge_absorb_init(&absorber, sponge, sponge_flags);
+    sponge_absorb_update(&absorber, pwd, pwdlen);
+    sponge_absorb_update(&absorber, salt, saltlen);
+    sponge_absorb_update(&absorber, params, sizeof(params));
+    sponge_absorb_final(&absorber);
     return;
 }
 
-#ifdef USE_PHS_INTERFACE
-static
+/*
+ * The row loops of lyra2_impl, each duplexing one row with the sponge state
+ * kept in registers.
+ */
+GEN_SPONGE_ROW_DUPLEXING(setup_row0,
+    sponge_squeeze(&row_sponge, m0[matrix_col(ncols, ncols-1-col)], sizeof(block_t),
+        SPONGE_FLAG_REDUCED | SPONGE_FLAG_EXTENDED_RATE |
+        SPONGE_FLAG_ASSUME_PADDING | flags);,
+    block_t *m0, int flags)
+
+GEN_SPONGE_ROW_DUPLEXING(setup_row1,
+    const uint64_t fwd = matrix_col(ncols, col);
+    const uint64_t rev = matrix_col(ncols, ncols-1-col);
+    sponge_reduced_extended_duplexing(&row_sponge, m0[fwd], m1[rev], flags);
+    block_xor(m1[rev], m1[rev], m0[fwd]);,
+    block_t *m0, block_t *m1, int flags)
+
+GEN_SPONGE_ROW_DUPLEXING(setup_row2,
+    const uint64_t fwd = matrix_col(ncols, col);
+    const uint64_t rev = matrix_col(ncols, ncols-1-col);
+    block_wordwise_add(rand, m0[fwd], m1[fwd]);
+    sponge_reduced_extended_duplexing(&row_sponge, rand, rand, flags);
+    block_xor(m2[rev], m1[fwd], rand);
+    block_xor_rotR(m0[fwd], m0[fwd], rand, 1);,
+    block_t *m0, block_t *m1, block_t *m2, block_t rand, int flags)
+
+/*
+ * Filling-phase row, fused into a single pass over the columns: each input
+ * block is loaded once into a local block, and the duplexed block is combined
+ * with them and written out to both destination rows straight from
+ * registers. The last duplexed block is left in |rand|.
+ */
+static ALWAYS_INLINE void
+filling_row(sponge_t *sponge, unsigned int ncols, matrix_t matrix,
+            block_t rand, uint64_t row0, uint64_t row1, uint64_t prev0,
+            uint64_t prev1, int flags) {
+    sponge_t row_sponge = *sponge;
+    block_t duplexed;
+    block_t *m0 = matrix_row(matrix, row0), *m1 = matrix_row(matrix, row1);
+    const block_t *p0 = matrix_row(matrix, prev0), *p1 = matrix_row(matrix, prev1);
+
+    for (unsigned int col = 0; col < ncols; col++) {
+        const uint64_t fwd = matrix_col(ncols, col);
+        const uint64_t rev = matrix_col(ncols, ncols-1-col);
+
+        block_wordwise_add(duplexed, m1[fwd], p0[fwd]);
+        block_wordwise_add(duplexed, duplexed, p1[fwd]);
+        sponge_reduced_extended_duplexing(&row_sponge, duplexed, duplexed, flags);
+
+        block_xor(m0[rev], p0[fwd], duplexed);
+        block_xor_rotR(m1[fwd], m1[fwd], duplexed, 1);
+    }
+
+    memcpy(rand, duplexed, sizeof(block_t));
+    *sponge = row_sponge;
+}
+
+/*
+ * Wandering-phase row. As in filling_row, the duplexed block stays local to
+ * the kernel, and the column indices for the next block are extracted from
+ * it while it is still in registers. The write-backs to |row0| and |row1|
+ * are a plain XOR and a XOR with the block rotated by one Rt unit.
+ *
+ * With LYRA2_PREFETCH, the blocks of |prev0| and |prev1| for the next column
+ * are prefetched before the write-backs, and after the last column, so are
+ * the first blocks of the rows the next call will visit.
+ */
+static ALWAYS_INLINE void
+wandering_row(sponge_t *sponge, unsigned int ncols, divisor_t cols,
+              matrix_t matrix, divisor_t rows, block_t rand, uint64_t row0,
+              uint64_t row1, uint64_t prev0, uint64_t prev1, uint64_t *col0,
+              uint64_t *col1, int flags) {
+    sponge_t row_sponge = *sponge;
+    block_t duplexed;
+    block_t *m0 = matrix_row(matrix, row0), *m1 = matrix_row(matrix, row1);
+    const block_t *p0 = matrix_row(matrix, prev0), *p1 = matrix_row(matrix, prev1);
+    uint64_t c0 = *col0, c1 = *col1;
+    uint64_t next0 = divisor_mod(block_get_lsw_from_bword(rand, 2), cols);
+    uint64_t next1 = divisor_mod(block_get_lsw_from_bword(rand, 3), cols);
+#ifndef LYRA2_PREFETCH
+    (void) rows;
 #endif
-int
-lyra2(const char *key, uint32_t keylen, const char *pwd, uint32_t pwdlen,
-      const char *salt, uint32_t saltlen, uint32_t R, uint32_t C,
-      uint32_t T) {
 
-    sponge_t *sponge = sponge_new();
+    for (unsigned int col = 0; col < ncols; col++) {
+        const uint64_t fwd = matrix_col(ncols, col);
+        c0 = next0;
+        c1 = next1;
+
+        block_wordwise_add(duplexed, m0[fwd], m1[fwd]);
+        block_wordwise_add(duplexed, duplexed, p0[matrix_col(ncols, c0)]);
+        block_wordwise_add(duplexed, duplexed, p1[matrix_col(ncols, c1)]);
+        sponge_reduced_extended_duplexing(&row_sponge, duplexed, duplexed, flags);
+
+        next0 = divisor_mod(block_get_lsw_from_bword(duplexed, 2), cols);
+        next1 = divisor_mod(block_get_lsw_from_bword(duplexed, 3), cols);
+#ifdef LYRA2_PREFETCH
+        if (col + 1 < ncols) {
+            block_prefetch(p0[matrix_col(ncols, next0)]);
+            block_prefetch(p1[matrix_col(ncols, next1)]);
+        } else {
+            // |row0| and |row1| become the next call's |prev0| and |prev1|
+            const uint64_t first = matrix_col(ncols, 0);
+            block_prefetch(matrix_row(matrix, divisor_mod(block_get_lsw_from_bword(duplexed, 0), rows))[first]);
+            block_prefetch(matrix_row(matrix, divisor_mod(block_get_lsw_from_bword(duplexed, 1), rows))[first]);
+            block_prefetch(m0[matrix_col(ncols, next0)]);
+            block_prefetch(m1[matrix_col(ncols, next1)]);
+        }
+#endif
+
+        block_xor(m0[fwd], m0[fwd], duplexed);
+        block_xor_rotR(m1[fwd], m1[fwd], duplexed, 1);
+    }
+
+    memcpy(rand, duplexed, sizeof(block_t));
+    *col0 = c0;
+    *col1 = c1;
+    *sponge = row_sponge;
+}
+
+/*
+ * Wandering-phase row of parallel Lyra2, which updates only |row0|: every
+ * column is combined with the same column of |row0p|, from any thread's
+ * slice, and a pseudorandom column of |prev0|.
+ */
+static ALWAYS_INLINE void
+wandering_row_parallel(sponge_t *sponge, unsigned int ncols, divisor_t cols,
+                       matrix_t matrix, block_t rand, uint64_t row0,
+                       uint64_t row0p, uint64_t prev0, int flags) {
+    sponge_t row_sponge = *sponge;
+    block_t duplexed;
+    block_t *m0 = matrix_row(matrix, row0);
+    const block_t *m0p = matrix_row(matrix, row0p), *p0 = matrix_row(matrix, prev0);
+
+    memcpy(duplexed, rand, sizeof(block_t));
+    for (unsigned int col = 0; col < ncols; col++) {
+        const uint64_t fwd = matrix_col(ncols, col);
+        uint64_t c0 = divisor_mod(block_get_lsw_from_bword(duplexed, 3), cols);
+
+        block_wordwise_add(duplexed, m0[fwd], p0[matrix_col(ncols, c0)]);
+        block_wordwise_add(duplexed, duplexed, m0p[fwd]);
+        sponge_reduced_extended_duplexing(&row_sponge, duplexed, duplexed, flags);
+
+        block_xor(m0[fwd], m0[fwd], duplexed);
+    }
+
+    memcpy(rand, duplexed, sizeof(block_t));
+    *sponge = row_sponge;
+}
+
+/*
+ * A sponge and a matrix of up to |max_R| rows of |max_C| columns, kept
+ * between calls so that hashing with a context allocates nothing, and only
+ * the first hash takes page faults on the matrix.
+ */
+/*
+ * The setup phase fills three rows, and the wrap-up reads a block of the last
+ * row visited, so there must be at least one wandering pass. Callers check
+ * the costs before allocating anything for them.
+ */
+static inline bool
+costs_valid(uint32_t R, uint32_t C, uint32_t T) {
+    return R >= 3 && C > 0 && T > 0;
+}
+
+struct lyra2_ctx {
+    sponge_t *sponge;
+    matrix_t matrix;
+    uint32_t max_R, max_C;
+};
 
-    size_t basil_size = pwdlen + saltlen + 6 * sizeof(int);
-    size_t matrix_size = R * C * sizeof(block_t);
-    if (matrix_size < basil_size + SPONGE_RATE_SIZE_BYTES) {
-        // can't fit the basil inside the matrix for the initial
-        // absorb operation
+static bool
+lyra2_ctx_init(struct lyra2_ctx *ctx, uint32_t max_R, uint32_t max_C) {
+    ctx->max_R = max_R;
+    ctx->max_C = max_C;
+    if (!matrix_alloc(&ctx->matrix, max_R, max_C)) {
+        return false;
+    }
+
+    ctx->sponge = sponge_new();
+    if (!ctx->sponge) {
+        matrix_free(&ctx->matrix);
+        return false;
+    }
+
+    return true;
+}
+
+static void
+lyra2_ctx_destroy(struct lyra2_ctx *ctx) {
+    sponge_destroy(ctx->sponge);
+    matrix_free(&ctx->matrix);
+}
+
+static ALWAYS_INLINE int
+lyra2_ctx_impl(struct lyra2_ctx *ctx, char *key, uint32_t keylen,
+               const char *pwd, uint32_t pwdlen, const char *salt,
+               uint32_t saltlen, uint32_t R, uint32_t C, uint32_t T,
+               int sponge_flags) {
+    if (!costs_valid(R, C, T) || R > ctx->max_R || C > ctx->max_C) {
         return -1;
     }
 
-    block_t (*matrix)[C] = _mm_malloc(R * sizeof(*matrix), SPONGE_MEM_ALIGNMENT);
-    assert(matrix_size == R * sizeof(*matrix));
+    sponge_t *sponge = ctx->sponge;
+    sponge_reset(sponge);
+
+    // rows of fewer columns than the context was created for are packed
+    // together at the start of its matrix
+    matrix_t matrix = ctx->matrix;
+    matrix.stride = C * sizeof(block_t) + LYRA2_ROW_PAD;
 
     /* Bootstrapping phase */
     block_t rand;
     int64_t gap = 1, stp = 1;
     uint64_t prev0 = 2, row0 = 0, row1 = 1, prev1 = 0, wnd = 2;
 
-    write_basil((uint8_t *) matrix, keylen, pwd, pwdlen, salt, saltlen, R, C, T);
-    sponge_absorb(sponge, (sponge_word_t *) matrix, basil_size, 0);
+    absorb_basil(sponge, keylen, pwd, pwdlen, salt, saltlen, R, C, T,
+                 sponge_flags);
+
+    /* Setup phase */
+    block_t *m0 = matrix_row(matrix, 0), *m1 = matrix_row(matrix, 1);
+    setup_row0(sponge, C, m0, sponge_flags);
+    setup_row1(sponge, C, m0, m1, sponge_flags);
+    setup_row2(sponge, C, m0, m1, matrix_row(matrix, 2), rand, sponge_flags);
+
+    /* Filling loop */
+    for (row0 = 3; row0 < R; row0++) {
+        filling_row(sponge, C, matrix, rand, row0, row1, prev0, prev1,
+                    sponge_flags);
+        prev0 = row0;
+        prev1 = row1;
+        row1 = (row1 + stp) & (wnd - 1);
+        if (row1 == 0) {
+            stp = wnd + gap;
+            wnd = 2*wnd;
+            gap = -gap;
+        }
+    }
+
+    /* Wandering phase */
+    const divisor_t rows = divisor_new(R), cols = divisor_new(C);
+    uint64_t col0 = 0, col1 = 0;
+    for (uint64_t tau = 1; tau <= T; tau++) {
+        for (unsigned int i = 0; i < R; i++) {
+            row0 = divisor_mod(block_get_lsw_from_bword(rand, 0), rows);
+            row1 = divisor_mod(block_get_lsw_from_bword(rand, 1), rows);
+            wandering_row(sponge, C, cols, matrix, rows, rand, row0, row1,
+                          prev0, prev1, &col0, &col1, sponge_flags);
+            prev0 = row0;
+            prev1 = row1;
+        }
+    }
+
+    sponge_absorb(sponge, matrix_row(matrix, row0)[matrix_col(C, col0)], sizeof(block_t),
+        SPONGE_FLAG_ASSUME_PADDING | SPONGE_FLAG_EXTENDED_RATE | sponge_flags);
+    sponge_squeeze_unaligned(sponge, (sponge_word_t *) key, keylen,
+        SPONGE_FLAG_EXTENDED_RATE | sponge_flags);
+    return 0;
+}
+
+static ALWAYS_INLINE int
+lyra2_impl(char *key, uint32_t keylen, const char *pwd, uint32_t pwdlen,
+           const char *salt, uint32_t saltlen, uint32_t R, uint32_t C,
+           uint32_t T, int sponge_flags) {
+    struct lyra2_ctx ctx;
+    if (!costs_valid(R, C, T) || !lyra2_ctx_init(&ctx, R, C)) {
+        return -1;
+    }
+
+    int ret = lyra2_ctx_impl(&ctx, key, keylen, pwd, pwdlen, salt, saltlen,
+                             R, C, T, sponge_flags);
+    lyra2_ctx_destroy(&ctx);
+    return ret;
+}
+
+/*
+ * Parallel Lyra2, as specified by the reference implementation built with
+ * nPARALLEL set to the number of threads. The matrix is split into one slice
+ * of R / nthreads rows per thread, and each thread runs its own sponge over
+ * its slice, visiting one other slice at a time during the filling phase and
+ * reading from any of them during the wandering phase. The key is the XOR of
+ * the keys squeezed by each thread.
+ *
+ * The threads synchronize at the reference's LYRA2_PARALLEL_SIGMA sync points
+ * per phase. Within a phase, the reference lets a thread update the row of
+ * another slice while that slice's owner may still need to read it, which
+ * makes its output timing-dependent; here the visiting thread waits on the
+ * owner's progress instead, giving the result of all threads running in
+ * lockstep.
+ *
+ * Besides that, reproducing the reference's output takes patching it to absorb
+ * column 0 in the wrap-up, write the third setup row into the thread's own
+ * slice, open its parallel region with an unconditional `omp parallel` (on
+ * current GCC, _OPENMP matches neither of its version gates, so it runs
+ * single-threaded) and wait at a barrier before free(threadSliceMatrix), as
+ * the wrap-up reads memMatrix[row0] from thread 0's slice.
+ */
+#ifndef LYRA2_PARALLEL_SIGMA
+#define LYRA2_PARALLEL_SIGMA 2
+#endif
+
+struct lyra2_parallel_progress {
+    // number of rows of the slice its owner is done with in the filling phase
+    uint64_t rows;
+    // keep each counter on its own cache line
+    uint8_t padding[64 - sizeof(uint64_t)];
+};
+
+struct lyra2_parallel_job {
+    char *keys;
+    uint32_t keylen;
+    const char *pwd;
+    uint32_t pwdlen;
+    const char *salt;
+    uint32_t saltlen;
+    uint32_t R, C, T;
+    unsigned int nthreads;
+    uint64_t slice;
+    matrix_t matrix;
+    sponge_t **sponges;
+    struct lyra2_parallel_progress *progress;
+    struct lyra2_barrier barrier;
+};
+
+static void
+lyra2_parallel_thread(void *arg, unsigned int thread) {
+    struct lyra2_parallel_job *job = arg;
+    const uint32_t C = job->C;
+    const uint64_t nthreads = job->nthreads, slice = job->slice;
+    const uint64_t start = thread * slice, half = slice / 2;
+    matrix_t matrix = job->matrix;
+    uint64_t *rows_done = &job->progress[thread].rows;
+
+    // allocated by lyra2_parallel_impl, which can still report failure
+    sponge_t *sponge = job->sponges[thread];
+
+    /* Bootstrapping phase */
+    absorb_basil(sponge, job->keylen, job->pwd, job->pwdlen, job->salt,
+                 job->saltlen, job->R, C, job->T, 0);
+
+    // every thread's sponge also absorbs the thread count and its index
+    sponge_word_t index[SPONGE_RATE_LENGTH];
+    memset(index, 0, sizeof(index));
+    ((uint8_t *) index)[sizeof(index) / 2 - 1] = nthreads;
+    ((uint8_t *) index)[sizeof(index) - 1] = thread;
+    sponge_absorb(sponge, index, sizeof(index), SPONGE_FLAG_ASSUME_PADDING);
+
+    /* Setup phase */
+    block_t rand;
+    int64_t gap = 1, stp = 1;
+    uint64_t prev0 = 2, row0 = 0, row1 = 1, prev1 = 0, wnd = 2;
+    uint64_t visited = thread, sync = 1;
+    uint64_t sync_row = sync * (slice / LYRA2_PARALLEL_SIGMA) - 1;
+
+    // each thread's slice goes on its own node, before the setup phase
+    // first touches it
+    lyra2_matrix_bind_local(matrix_row(matrix, start), slice * matrix.stride);
+
+    // setup_row2 always sets rand, but GCC cannot tell once C is read from
+    // the job
+    memset(rand, 0, sizeof(rand));
+    block_t *m0 = matrix_row(matrix, start), *m1 = matrix_row(matrix, start + 1);
+    setup_row0(sponge, C, m0, 0);
+    setup_row1(sponge, C, m0, m1, 0);
+    setup_row2(sponge, C, m0, m1, matrix_row(matrix, start + 2), rand, 0);
+    __atomic_store_n(rows_done, 3, __ATOMIC_RELEASE);
+
+    /* Filling loop */
+    for (row0 = 3; row0 < slice; row0++) {
+        // row1 < row0 - 1, so this only waits on threads that are behind
+        lyra2_pool_wait_geq(&job->progress[visited].rows, row1 + 2);
+        filling_row(sponge, C, matrix, rand, start + row0,
+                    visited * slice + row1, start + prev0,
+                    visited * slice + prev1, 0);
+        __atomic_store_n(rows_done, row0 + 1, __ATOMIC_RELEASE);
+
+        prev0 = row0;
+        prev1 = row1;
+        row1 = (row1 + stp) & (wnd - 1);
+        if (row1 == 0) {
+            stp = wnd + gap;
+            wnd = 2*wnd;
+            gap = -gap;
+        }
+
+        if (row0 >= sync_row) {
+            sync++;
+            sync_row = sync * (slice / LYRA2_PARALLEL_SIGMA) - 1;
+            visited = (visited + 1) % nthreads;
+            lyra2_barrier_wait(&job->barrier);
+        }
+    }
+
+    lyra2_barrier_wait(&job->barrier);
+
+    /* Wandering phase */
+    // Threads update one half of their slice and read from the other half
+    // of the others', swapping halves at each sync point.
+    sync = 1;
+    sync_row = sync * (slice / LYRA2_PARALLEL_SIGMA) - 1;
+    prev0 = half - 1;
+    uint64_t side = sync % 2;
+    const divisor_t halves = divisor_new(half), threads = divisor_new(nthreads);
+    const divisor_t cols = divisor_new(C);
+    for (uint64_t tau = 1; tau <= job->T; tau++) {
+        for (uint64_t i = 0; i < slice; i++) {
+            row0 = divisor_mod(block_get_lsw_from_bword(rand, 0), halves);
+            uint64_t row0p = divisor_mod(block_get_lsw_from_bword(rand, 1), halves);
+            uint64_t j0 = divisor_mod(block_get_lsw_from_bword(rand, 2), threads);
+            wandering_row_parallel(sponge, C, cols, matrix, rand,
+                                   start + row0 + half * side,
+                                   j0 * slice + row0p + half * (1 - side),
+                                   start + prev0 + half * side, 0);
+
+            if (i >= sync_row) {
+                sync++;
+                sync_row = sync * (slice / LYRA2_PARALLEL_SIGMA) - 1;
+                side = sync % 2;
+                lyra2_barrier_wait(&job->barrier);
+            }
+            prev0 = row0;
+        }
+
+        lyra2_barrier_wait(&job->barrier);
+    }
+
+    /* Wrap-up phase */
+    // As in the reference, this absorbs the first column of row |row0| of the
+    // whole matrix, not of the thread's slice.
+    sponge_absorb(sponge, matrix_row(matrix, row0)[matrix_col(C, 0)], sizeof(block_t),
+        SPONGE_FLAG_ASSUME_PADDING | SPONGE_FLAG_EXTENDED_RATE);
+    sponge_squeeze_unaligned(sponge,
+        (sponge_word_t *) (job->keys + (size_t) thread * job->keylen),
+        job->keylen, SPONGE_FLAG_EXTENDED_RATE);
+}
+
+static int
+lyra2_parallel_impl(char *key, uint32_t keylen, const char *pwd,
+                    uint32_t pwdlen, const char *salt, uint32_t saltlen,
+                    uint32_t R, uint32_t C, uint32_t T, unsigned int nthreads) {
+    if (nthreads == 1) {
+        return lyra2_impl(key, keylen, pwd, pwdlen, salt, saltlen, R, C, T, 0);
+    }
+
+    // each slice needs room for the three rows of the setup phase
+    if (nthreads == 0 || nthreads > LYRA2_MAX_THREADS ||
+        !costs_valid(R / nthreads, C, T)) {
+        return -1;
+    }
+
+    struct lyra2_parallel_job job = {
+        .keylen = keylen, .pwd = pwd, .pwdlen = pwdlen, .salt = salt,
+        .saltlen = saltlen, .R = R, .C = C, .T = T, .nthreads = nthreads,
+        .slice = R / nthreads,
+    };
+
+    bool allocated = matrix_alloc(&job.matrix, nthreads * job.slice, C);
+    job.keys = malloc((size_t) nthreads * keylen);
+    job.progress = calloc(nthreads, sizeof(*job.progress));
+    job.sponges = calloc(nthreads, sizeof(*job.sponges));
+    for (unsigned int thread = 0; job.sponges && thread < nthreads; thread++) {
+        job.sponges[thread] = sponge_new();
+        allocated = allocated && job.sponges[thread];
+    }
+
+    lyra2_barrier_init(&job.barrier, nthreads);
+
+    int ret = -1;
+    if (allocated && job.keys && job.progress && job.sponges) {
+        ret = lyra2_pool_run(nthreads, lyra2_parallel_thread, &job);
+    }
+
+    if (ret == 0) {
+        memcpy(key, job.keys, keylen);
+        for (unsigned int thread = 1; thread < nthreads; thread++) {
+            for (uint32_t i = 0; i < keylen; i++) {
+                key[i] ^= job.keys[(size_t) thread * keylen + i];
+            }
+        }
+    }
+
+    for (unsigned int thread = 0; job.sponges && thread < nthreads; thread++) {
+        sponge_destroy(job.sponges[thread]);
+    }
+
+    free(job.sponges);
+    free(job.progress);
+    free(job.keys);
+    matrix_free(&job.matrix);
+    return ret;
+}
+
+#ifdef HAVE_AVX2
+/*
+ * Multi-buffer Lyra2: four instances sharing R, C and T, each with its own
+ * matrix in the regular layout, driven by a single sponge_x4_t. Only the
+ * sponge runs transposed; the block operations are the same as in lyra2(), so
+ * the wandering phase is free to visit different rows and columns per lane.
+ */
+#define nlanes SPONGE_X4_LANES
+
+static int
+lyra2_x4_impl(char *const key[static nlanes], uint32_t keylen,
+              const char *const pwd[static nlanes], const uint32_t pwdlen[static nlanes],
+              const char *const salt[static nlanes], const uint32_t saltlen[static nlanes],
+              uint32_t R, uint32_t C, uint32_t T) {
+    if (!costs_valid(R, C, T)) {
+        return -1;
+    }
+
+    if ((uint64_t) R * C > SIZE_MAX / (nlanes * sizeof(block_t))) {
+        return -1;
+    }
+
+    block_t (*matrix)[R][C] = sponge_aligned_malloc(nlanes * sizeof(*matrix));
+    sponge_x4_t *sponge = sponge_x4_new();
+    sponge_t *lane_sponge = sponge_new();
+    if (!matrix || !sponge || !lane_sponge) {
+        sponge_aligned_free(matrix);
+        sponge_x4_destroy(sponge);
+        sponge_destroy(lane_sponge);
+        return -1;
+    }
+
+    /* Bootstrapping phase */
+    // The basils can have different lengths, so each lane absorbs its own
+    // with a regular sponge before being moved into the x4 sponge.
+    for (unsigned int lane = 0; lane < nlanes; lane++) {
+        sponge_reset(lane_sponge);
+        absorb_basil(lane_sponge, keylen, pwd[lane], pwdlen[lane],
+                     salt[lane], saltlen[lane], R, C, T, 0);
+        sponge_x4_set_lane(sponge, lane, lane_sponge);
+    }
+
+    ALIGN(SPONGE_MEM_ALIGNMENT) block_t rand[nlanes];
+    sponge_word_t *rands[nlanes], *in[nlanes], *out[nlanes];
+    int64_t gap = 1, stp = 1;
+    uint64_t prev0 = 2, row0 = 0, row1 = 1, prev1 = 0, wnd = 2;
+
+    for (unsigned int lane = 0; lane < nlanes; lane++) {
+        rands[lane] = rand[lane];
+    }
 
     /* Setup phase */
     for (unsigned int col = 0; col < C; col++) {
-        int flags = 0;
-        flags |= SPONGE_FLAG_REDUCED;
-        flags |= SPONGE_FLAG_EXTENDED_RATE;
-        flags |= SPONGE_FLAG_ASSUME_PADDING;
-        sponge_squeeze(sponge, matrix[0][C-1-col], sizeof(block_t), flags);
+        for (unsigned int lane = 0; lane < nlanes; lane++) {
+            out[lane] = matrix[lane][0][C-1-col];
+        }
+        sponge_x4_reduced_extended_squeeze(sponge, out);
     }
 
     for (unsigned int col = 0; col < C; col++) {
-        sponge_reduced_extended_duplexing(sponge,
-            matrix[0][col], matrix[1][C-1-col]);
+        for (unsigned int lane = 0; lane < nlanes; lane++) {
+            in[lane] = matrix[lane][0][col];
+            out[lane] = matrix[lane][1][C-1-col];
+        }
+        sponge_x4_reduced_extended_duplexing(sponge, (const sponge_word_t **) in, out);
 
-        block_xor(matrix[1][C-1-col], matrix[1][C-1-col], matrix[0][col]);
+        for (unsigned int lane = 0; lane < nlanes; lane++) {
+            block_xor(matrix[lane][1][C-1-col], matrix[lane][1][C-1-col], matrix[lane][0][col]);
+        }
     }
 
     for (unsigned int col = 0; col < C; col++) {
-        block_wordwise_add(rand, matrix[0][col], matrix[1][col]);
-        sponge_reduced_extended_duplexing(sponge, rand, rand);
-        block_xor(matrix[2][C-1-col], matrix[1][col], rand);
-        block_xor_rotR(matrix[0][col], matrix[0][col], rand, 1);
+        for (unsigned int lane = 0; lane < nlanes; lane++) {
+            block_wordwise_add(rand[lane], matrix[lane][0][col], matrix[lane][1][col]);
+        }
+        sponge_x4_reduced_extended_duplexing(sponge, (const sponge_word_t **) rands, rands);
+        for (unsigned int lane = 0; lane < nlanes; lane++) {
+            block_xor(matrix[lane][2][C-1-col], matrix[lane][1][col], rand[lane]);
+            block_xor_rotR(matrix[lane][0][col], matrix[lane][0][col], rand[lane], 1);
+        }
     }
 
     /* Filling loop */
     for (row0 = 3; row0 < R; row0++) {
         for (unsigned int col = 0; col < C; col++) {
-            block_wordwise_add(rand, matrix[row1][col], matrix[prev0][col]);
-            block_wordwise_add(rand, rand, matrix[prev1][col]);
-            sponge_reduced_extended_duplexing(sponge, rand, rand);
-            block_xor(matrix[row0][C-1-col], matrix[prev0][col], rand);
-            block_xor_rotR(matrix[row1][col], matrix[row1][col], rand, 1);
+            for (unsigned int lane = 0; lane < nlanes; lane++) {
+                block_wordwise_add(rand[lane], matrix[lane][row1][col], matrix[lane][prev0][col]);
+                block_wordwise_add(rand[lane], rand[lane], matrix[lane][prev1][col]);
+            }
+            sponge_x4_reduced_extended_duplexing(sponge, (const sponge_word_t **) rands, rands);
+            for (unsigned int lane = 0; lane < nlanes; lane++) {
+                block_xor(matrix[lane][row0][C-1-col], matrix[lane][prev0][col], rand[lane]);
+                block_xor_rotR(matrix[lane][row1][col], matrix[lane][row1][col], rand[lane], 1);
+            }
         }
         prev0 = row0;
         prev1 = row1;
@@ -137,43 +885,733 @@ lyra2(const char *key, uint32_t keylen, const char *pwd, uint32_t pwdlen,
     }
 
     /* Wandering phase */
-    uint64_t col0 = 0, col1 = 0;
-    for (unsigned int tau = 1; tau <= T; tau++) {
+    uint64_t rows0[nlanes], rows1[nlanes], prevs0[nlanes], prevs1[nlanes];
+    uint64_t cols0[nlanes], cols1[nlanes];
+    for (unsigned int lane = 0; lane < nlanes; lane++) {
+        rows0[lane] = row0;
+        prevs0[lane] = prev0;
+        prevs1[lane] = prev1;
+        cols0[lane] = 0;
+    }
+
+    const divisor_t rows = divisor_new(R), cols = divisor_new(C);
+    for (uint64_t tau = 1; tau <= T; tau++) {
         for (unsigned int i = 0; i < R; i++) {
-            row0 = block_get_lsw_from_bword(rand, 0) % R;
-            row1 = block_get_lsw_from_bword(rand, 1) % R;
+            for (unsigned int lane = 0; lane < nlanes; lane++) {
+                rows0[lane] = divisor_mod(block_get_lsw_from_bword(rand[lane], 0), rows);
+                rows1[lane] = divisor_mod(block_get_lsw_from_bword(rand[lane], 1), rows);
+            }
 
             for (unsigned int col = 0; col < C; col++) {
-                col0 = block_get_lsw_from_bword(rand, 2) % C,
-                col1 = block_get_lsw_from_bword(rand, 3) % C;
+                for (unsigned int lane = 0; lane < nlanes; lane++) {
+                    cols0[lane] = divisor_mod(block_get_lsw_from_bword(rand[lane], 2), cols);
+                    cols1[lane] = divisor_mod(block_get_lsw_from_bword(rand[lane], 3), cols);
 
-                block_wordwise_add(rand, matrix[row0][col], matrix[row1][col]);
-                block_wordwise_add(rand, rand, matrix[prev0][col0]);
-                block_wordwise_add(rand, rand, matrix[prev1][col1]);
-                sponge_reduced_extended_duplexing(sponge, rand, rand);
+                    block_wordwise_add(rand[lane], matrix[lane][rows0[lane]][col],
+                                       matrix[lane][rows1[lane]][col]);
+                    block_wordwise_add(rand[lane], rand[lane],
+                                       matrix[lane][prevs0[lane]][cols0[lane]]);
+                    block_wordwise_add(rand[lane], rand[lane],
+                                       matrix[lane][prevs1[lane]][cols1[lane]]);
+                }
+                sponge_x4_reduced_extended_duplexing(sponge, (const sponge_word_t **) rands, rands);
 
-                block_xor_rotR(matrix[row0][col], matrix[row0][col], rand, 0);
-                block_xor_rotR(matrix[row1][col], matrix[row1][col], rand, 1);
+                for (unsigned int lane = 0; lane < nlanes; lane++) {
+                    block_xor_rotR(matrix[lane][rows0[lane]][col],
+                                   matrix[lane][rows0[lane]][col], rand[lane], 0);
+                    block_xor_rotR(matrix[lane][rows1[lane]][col],
+                                   matrix[lane][rows1[lane]][col], rand[lane], 1);
+                }
             }
-            prev0 = row0;
-            prev1 = row1;
+            memcpy(prevs0, rows0, sizeof(rows0));
+            memcpy(prevs1, rows1, sizeof(rows1));
         }
     }
 
-    sponge_absorb(sponge, matrix[row0][col0], sizeof(block_t),
+    /* Wrap-up phase */
+    // Like the bootstrapping phase, this is done lane by lane, as each lane
+    // absorbs a different block.
+    for (unsigned int lane = 0; lane < nlanes; lane++) {
+        sponge_x4_get_lane(sponge, lane, lane_sponge);
+        sponge_absorb(lane_sponge, matrix[lane][rows0[lane]][cols0[lane]], sizeof(block_t),
+            SPONGE_FLAG_ASSUME_PADDING | SPONGE_FLAG_EXTENDED_RATE);
+        sponge_squeeze_unaligned(lane_sponge, (sponge_word_t *) key[lane], keylen,
+            SPONGE_FLAG_EXTENDED_RATE);
+    }
+
+    sponge_aligned_free(matrix);
+    sponge_destroy(lane_sponge);
+    sponge_x4_destroy(sponge);
+    return 0;
+}
+
+#undef nlanes
+#else
+static int
+lyra2_x4_impl(char *const key[static LYRA2_X4_LANES], uint32_t keylen,
+              const char *const pwd[static LYRA2_X4_LANES], const uint32_t pwdlen[static LYRA2_X4_LANES],
+              const char *const salt[static LYRA2_X4_LANES], const uint32_t saltlen[static LYRA2_X4_LANES],
+              uint32_t R, uint32_t C, uint32_t T) {
+    for (unsigned int lane = 0; lane < LYRA2_X4_LANES; lane++) {
+        int ret = lyra2_impl(key[lane], keylen, pwd[lane], pwdlen[lane],
+                             salt[lane], saltlen[lane], R, C, T, 0);
+        if (ret) {
+            return ret;
+        }
+    }
+
+    return 0;
+}
+#endif // HAVE_AVX2
+
+/*
+ * Interleaved Lyra2: up to LYRA2_MAX_LANES independent instances in a single
+ * thread, each with its own costs, sponge and matrix, advanced round-robin by
+ * one column at a time. A single instance is a serial chain, as every
+ * duplexing picks the blocks the next one reads, so once its matrix outgrows
+ * the caches it spends much of the wandering phase waiting on memory. Here,
+ * each lane's column step ends by prefetching the blocks of its next steps,
+ * which are then fetched while the other lanes compute theirs.
+ *
+ * Each lane hashes with its own context, and takes the next job from the list
+ * as soon as its current one is done.
+ */
+struct interleaved_job {
+    char *key;
+    const char *pwd, *salt;
+    uint32_t keylen, pwdlen, saltlen;
+    uint32_t R, C, T;
+};
+
+enum interleaved_phase {
+    PHASE_FILLING,
+    PHASE_WANDERING
+};
+
+struct interleaved_lane {
+    block_t rand;
+    struct lyra2_ctx *ctx;
+    matrix_t matrix;
+    struct interleaved_job job;
+    divisor_t rows, cols;
+    enum interleaved_phase phase;
+    uint32_t col;
+    // the rows and, in the wandering phase, the columns of the next step
+    uint64_t row0, row1, prev0, prev1, col0, col1;
+    // the filling phase's row1 window, and the wandering phase's progress
+    int64_t gap, stp;
+    uint64_t wnd, row, tau;
+};
+
+/*
+ * Pick the columns of the next wandering step from |rand|, the block the
+ * previous step duplexed, and at the start of a row its rows as well. The
+ * blocks at the picked columns are prefetched, and so are those of the rows
+ * being updated one step further ahead, so that a row's blocks keep arriving
+ * before they are needed.
+ */
+static ALWAYS_INLINE void
+interleaved_lane_wander(struct interleaved_lane *lane, bool new_row) {
+    const uint32_t C = lane->job.C;
+    if (new_row) {
+        lane->row0 = divisor_mod(block_get_lsw_from_bword(lane->rand, 0), lane->rows);
+        lane->row1 = divisor_mod(block_get_lsw_from_bword(lane->rand, 1), lane->rows);
+    }
+    lane->col0 = divisor_mod(block_get_lsw_from_bword(lane->rand, 2), lane->cols);
+    lane->col1 = divisor_mod(block_get_lsw_from_bword(lane->rand, 3), lane->cols);
+
+    const uint64_t fwd = matrix_col(C, lane->col);
+    if (new_row) {
+        block_prefetch(matrix_row(lane->matrix, lane->row0)[fwd]);
+        block_prefetch(matrix_row(lane->matrix, lane->row1)[fwd]);
+    }
+    if (lane->col + 1 < C) {
+        const uint64_t ahead = matrix_col(C, lane->col + 1);
+        block_prefetch(matrix_row(lane->matrix, lane->row0)[ahead]);
+        block_prefetch(matrix_row(lane->matrix, lane->row1)[ahead]);
+    }
+    block_prefetch(matrix_row(lane->matrix, lane->prev0)[matrix_col(C, lane->col0)]);
+    block_prefetch(matrix_row(lane->matrix, lane->prev1)[matrix_col(C, lane->col1)]);
+}
+
+static void
+interleaved_lane_start_wandering(struct interleaved_lane *lane) {
+    lane->phase = PHASE_WANDERING;
+    lane->row = 0;
+    lane->tau = 1;
+    interleaved_lane_wander(lane, true);
+}
+
+/*
+ * Give the lane a new job, and run its bootstrapping and setup phases right
+ * away: the setup phase only writes three rows in sequence, which leaves
+ * nothing for interleaving to hide.
+ */
+static void
+interleaved_lane_start(struct interleaved_lane *lane,
+                       const struct interleaved_job *job) {
+    const uint32_t C = job->C;
+    sponge_t *sponge = lane->ctx->sponge;
+
+    lane->job = *job;
+    lane->matrix = lane->ctx->matrix;
+    lane->matrix.stride = C * sizeof(block_t) + LYRA2_ROW_PAD;
+    lane->rows = divisor_new(job->R);
+    lane->cols = divisor_new(C);
+
+    sponge_reset(sponge);
+    absorb_basil(sponge, job->keylen, job->pwd, job->pwdlen, job->salt,
+                 job->saltlen, job->R, C, job->T, 0);
+
+    block_t *m0 = matrix_row(lane->matrix, 0), *m1 = matrix_row(lane->matrix, 1);
+    setup_row0(sponge, C, m0, 0);
+    setup_row1(sponge, C, m0, m1, 0);
+    setup_row2(sponge, C, m0, m1, matrix_row(lane->matrix, 2), lane->rand, 0);
+
+    lane->phase = PHASE_FILLING;
+    lane->col = 0;
+    lane->row0 = 3;
+    lane->row1 = 1;
+    lane->prev0 = 2;
+    lane->prev1 = 0;
+    lane->gap = 1;
+    lane->stp = 1;
+    lane->wnd = 2;
+    if (lane->row0 == job->R) {
+        interleaved_lane_start_wandering(lane);
+    }
+}
+
+static void
+interleaved_lane_filled_row(struct interleaved_lane *lane) {
+    lane->prev0 = lane->row0;
+    lane->prev1 = lane->row1;
+    lane->row1 = (lane->row1 + lane->stp) & (lane->wnd - 1);
+    if (lane->row1 == 0) {
+        lane->stp = lane->wnd + lane->gap;
+        lane->wnd = 2*lane->wnd;
+        lane->gap = -lane->gap;
+    }
+
+    if (++lane->row0 == lane->job.R) {
+        interleaved_lane_start_wandering(lane);
+    }
+}
+
+// Returns true once the lane's key has been squeezed.
+static bool
+interleaved_lane_wandered_row(struct interleaved_lane *lane) {
+    if (++lane->row == lane->job.R) {
+        lane->row = 0;
+        lane->tau++;
+    }
+
+    if (lane->tau <= lane->job.T) {
+        lane->prev0 = lane->row0;
+        lane->prev1 = lane->row1;
+        interleaved_lane_wander(lane, true);
+        return false;
+    }
+
+    /* Wrap-up phase */
+    sponge_t *sponge = lane->ctx->sponge;
+    block_t *last = matrix_row(lane->matrix, lane->row0);
+    sponge_absorb(sponge, last[matrix_col(lane->job.C, lane->col0)], sizeof(block_t),
         SPONGE_FLAG_ASSUME_PADDING | SPONGE_FLAG_EXTENDED_RATE);
-    sponge_squeeze_unaligned(sponge, (sponge_word_t *) key, keylen,
-        SPONGE_FLAG_EXTENDED_RATE);
+    sponge_squeeze_unaligned(sponge, (sponge_word_t *) lane->job.key,
+        lane->job.keylen, SPONGE_FLAG_EXTENDED_RATE);
+    return true;
+}
+
+/*
+ * Run one column of the lane's current filling or wandering row, as
+ * filling_row and wandering_row would, with a single duplexing between the
+ * two so that the compression function is inlined here. Returns true once the
+ * lane's key has been squeezed.
+ */
+static ALWAYS_INLINE bool
+interleaved_lane_step(struct interleaved_lane *lane) {
+    const matrix_t matrix = lane->matrix;
+    const uint32_t C = lane->job.C;
+    const bool filling = lane->phase == PHASE_FILLING;
+    const uint64_t fwd = matrix_col(C, lane->col);
+    block_t *m0 = matrix_row(matrix, lane->row0), *m1 = matrix_row(matrix, lane->row1);
+    const block_t *p0 = matrix_row(matrix, lane->prev0), *p1 = matrix_row(matrix, lane->prev1);
+
+    if (filling) {
+        block_wordwise_add(lane->rand, m1[fwd], p0[fwd]);
+        block_wordwise_add(lane->rand, lane->rand, p1[fwd]);
+    } else {
+        block_wordwise_add(lane->rand, m0[fwd], m1[fwd]);
+        block_wordwise_add(lane->rand, lane->rand, p0[matrix_col(C, lane->col0)]);
+        block_wordwise_add(lane->rand, lane->rand, p1[matrix_col(C, lane->col1)]);
+    }
+
+    sponge_reduced_extended_duplexing(lane->ctx->sponge, lane->rand, lane->rand, 0);
+
+    if (filling) {
+        block_xor(m0[matrix_col(C, C-1-lane->col)], p0[fwd], lane->rand);
+    } else {
+        block_xor(m0[fwd], m0[fwd], lane->rand);
+    }
+    block_xor_rotR(m1[fwd], m1[fwd], lane->rand, 1);
+
+    if (++lane->col < C) {
+        if (!filling) {
+            interleaved_lane_wander(lane, false);
+        }
+        return false;
+    }
+
+    lane->col = 0;
+    if (filling) {
+        interleaved_lane_filled_row(lane);
+        return false;
+    }
+
+    return interleaved_lane_wandered_row(lane);
+}
+
+typedef bool (*interleaved_job_getter_t)(const void *jobs, unsigned int i,
+                                         struct interleaved_job *job);
+
+/*
+ * Check all jobs before hashing any, and find the largest costs among them.
+ */
+static bool
+interleaved_jobs_check(const void *jobs, unsigned int njobs,
+                       interleaved_job_getter_t get_job, uint32_t *max_R,
+                       uint32_t *max_C) {
+    struct interleaved_job job;
+    *max_R = *max_C = 0;
+    for (unsigned int i = 0; i < njobs; i++) {
+        if (!get_job(jobs, i, &job) || !costs_valid(job.R, job.C, job.T)) {
+            return false;
+        }
+
+        *max_R = job.R > *max_R ? job.R : *max_R;
+        *max_C = job.C > *max_C ? job.C : *max_C;
+    }
+
+    return true;
+}
+
+static int
+lyra2_interleaved_ctx_impl(struct lyra2_ctx *const ctx[], unsigned int nlanes,
+                           const void *jobs, unsigned int njobs,
+                           interleaved_job_getter_t get_job) {
+    uint32_t max_R, max_C;
+    if (nlanes == 0 || nlanes > LYRA2_MAX_LANES ||
+        !interleaved_jobs_check(jobs, njobs, get_job, &max_R, &max_C)) {
+        return -1;
+    }
+
+    if (nlanes > njobs) {
+        nlanes = njobs;
+    }
+
+    struct interleaved_lane lanes[LYRA2_MAX_LANES];
+    struct interleaved_job job;
+    for (unsigned int l = 0; l < nlanes; l++) {
+        // any lane may take any job
+        if (max_R > ctx[l]->max_R || max_C > ctx[l]->max_C) {
+            return -1;
+        }
+
+        lanes[l].ctx = ctx[l];
+    }
+
+    for (unsigned int l = 0; l < nlanes; l++) {
+        get_job(jobs, l, &job);
+        interleaved_lane_start(&lanes[l], &job);
+    }
+
+    // Lanes whose last job is done are swapped to the end, so that the
+    // first |active| ones are all running.
+    unsigned int next = nlanes, active = nlanes;
+    while (active) {
+        for (unsigned int l = 0; l < active;) {
+            if (!interleaved_lane_step(&lanes[l])) {
+                l++;
+            } else if (next < njobs) {
+                get_job(jobs, next++, &job);
+                interleaved_lane_start(&lanes[l], &job);
+                l++;
+            } else {
+                // the lane swapped in steps next
+                struct interleaved_lane done = lanes[l];
+                lanes[l] = lanes[--active];
+                lanes[active] = done;
+            }
+        }
+    }
 
-    _mm_free(matrix);
-    sponge_destroy(sponge);
     return 0;
 }
 
+static int
+lyra2_interleaved_impl(const void *jobs, unsigned int njobs,
+                       unsigned int nlanes,
+                       interleaved_job_getter_t get_job) {
+    uint32_t max_R, max_C;
+    if (nlanes == 0 || nlanes > LYRA2_MAX_LANES ||
+        !interleaved_jobs_check(jobs, njobs, get_job, &max_R, &max_C)) {
+        return -1;
+    }
+
+    if (njobs == 0) {
+        return 0;
+    }
+
+    if (nlanes > njobs) {
+        nlanes = njobs;
+    }
+
+    struct lyra2_ctx ctxs[LYRA2_MAX_LANES], *ctx[LYRA2_MAX_LANES] = {NULL};
+    for (unsigned int l = 0; l < nlanes; l++) {
+        if (!lyra2_ctx_init(&ctxs[l], max_R, max_C)) {
+            while (l--) {
+                lyra2_ctx_destroy(&ctxs[l]);
+            }
+            return -1;
+        }
+
+        ctx[l] = &ctxs[l];
+    }
+
+    int ret = lyra2_interleaved_ctx_impl(ctx, nlanes, jobs, njobs, get_job);
+    for (unsigned int l = 0; l < nlanes; l++) {
+        lyra2_ctx_destroy(&ctxs[l]);
+    }
+
+    return ret;
+}
+
+STATIC_ASSERT(LYRA2_MAX_RHO == SPONGE_MAX_RHO, front_end_and_sponge_agree_on_max_rho);
+STATIC_ASSERT(LYRA2_BLOCK_WORDS == SPONGE_BLOCK_WORDS, front_end_and_sponge_agree_on_block_words);
+
+static inline int
+lyra2_sponge_flags(enum lyra2_sponge sponge, unsigned int rho) {
+    if (rho > LYRA2_MAX_RHO) {
+        return -1;
+    }
+
+    switch (sponge) {
+    case LYRA2_SPONGE_BLAKE2B:
+        return SPONGE_FLAG_RHO(rho);
+    case LYRA2_SPONGE_BLAMKA:
+        return SPONGE_FLAG_BLAMKA | SPONGE_FLAG_RHO(rho);
+    }
+
+    return -1;
+}
+
+/*
+ * Run lyra2_ctx_impl with constant sponge flags, so that each sponge
+ * configuration gets its own copy of Lyra2 with the compression function
+ * unrolled and no branches on the flags.
+ */
+static int
+lyra2_ctx_specialized(struct lyra2_ctx *ctx, char *key, uint32_t keylen,
+                      const char *pwd, uint32_t pwdlen, const char *salt,
+                      uint32_t saltlen, uint32_t R, uint32_t C, uint32_t T,
+                      int sponge_flags) {
+#define SPECIALIZE(flags)                                                   \
+    case flags:                                                             \
+        return lyra2_ctx_impl(ctx, key, keylen, pwd, pwdlen, salt, saltlen, \
+                              R, C, T, flags);
+
+    switch (sponge_flags) {
+    SPECIALIZE(SPONGE_FLAG_RHO(0))
+    SPECIALIZE(SPONGE_FLAG_RHO(1))
+    SPECIALIZE(SPONGE_FLAG_RHO(2))
+    SPECIALIZE(SPONGE_FLAG_RHO(3))
+    SPECIALIZE(SPONGE_FLAG_BLAMKA | SPONGE_FLAG_RHO(0))
+    SPECIALIZE(SPONGE_FLAG_BLAMKA | SPONGE_FLAG_RHO(1))
+    SPECIALIZE(SPONGE_FLAG_BLAMKA | SPONGE_FLAG_RHO(2))
+    SPECIALIZE(SPONGE_FLAG_BLAMKA | SPONGE_FLAG_RHO(3))
+    }
+
+#undef SPECIALIZE
+    return -1;
+}
+
+static int
+lyra2_specialized(char *key, uint32_t keylen, const char *pwd,
+                  uint32_t pwdlen, const char *salt, uint32_t saltlen,
+                  uint32_t R, uint32_t C, uint32_t T, int sponge_flags) {
+    struct lyra2_ctx ctx;
+    if (!costs_valid(R, C, T) || !lyra2_ctx_init(&ctx, R, C)) {
+        return -1;
+    }
+
+    int ret = lyra2_ctx_specialized(&ctx, key, keylen, pwd, pwdlen, salt,
+                                    saltlen, R, C, T, sponge_flags);
+    lyra2_ctx_destroy(&ctx);
+    return ret;
+}
+
+struct lyra2_ctx *
+lyra2_ctx_new(uint32_t max_R, uint32_t max_C) {
+    struct lyra2_ctx *ctx = malloc(sizeof(*ctx));
+    if (ctx && !lyra2_ctx_init(ctx, max_R, max_C)) {
+        free(ctx);
+        return NULL;
+    }
+
+    return ctx;
+}
+
+void
+lyra2_ctx_free(struct lyra2_ctx *ctx) {
+    if (ctx) {
+        lyra2_ctx_destroy(ctx);
+        free(ctx);
+    }
+}
+
 #ifdef USE_PHS_INTERFACE
+/*
+ * The basil holds the lengths as 32-bit integers, so the PHS functions reject
+ * longer inputs instead of truncating them.
+ */
+static inline bool
+phs_lengths_fit(size_t outlen, size_t inlen, size_t saltlen) {
+    return outlen <= UINT32_MAX && inlen <= UINT32_MAX && saltlen <= UINT32_MAX;
+}
+
 int
 PHS(void *out, size_t outlen, const void *in, size_t inlen, const void *salt,
     size_t saltlen, unsigned int t_cost, unsigned int m_cost) {
-    return lyra2(out, outlen, in, inlen, salt, saltlen, m_cost, PHS_NCOLS, t_cost);
+    if (!phs_lengths_fit(outlen, inlen, saltlen)) {
+        return -1;
+    }
+
+    return lyra2_impl(out, outlen, in, inlen, salt, saltlen, m_cost, PHS_NCOLS, t_cost, 0);
+}
+
+int
+PHS_with_ctx(struct lyra2_ctx *ctx, void *out, size_t outlen, const void *in,
+             size_t inlen, const void *salt, size_t saltlen,
+             unsigned int t_cost, unsigned int m_cost) {
+    if (!phs_lengths_fit(outlen, inlen, saltlen)) {
+        return -1;
+    }
+
+    return lyra2_ctx_impl(ctx, out, outlen, in, inlen, salt, saltlen, m_cost,
+                          PHS_NCOLS, t_cost, 0);
+}
+
+int
+PHS_with_sponge(void *out, size_t outlen, const void *in, size_t inlen,
+                const void *salt, size_t saltlen, unsigned int t_cost,
+                unsigned int m_cost, enum lyra2_sponge sponge,
+                unsigned int rho) {
+    int sponge_flags = lyra2_sponge_flags(sponge, rho);
+    if (sponge_flags < 0 || !phs_lengths_fit(outlen, inlen, saltlen)) {
+        return -1;
+    }
+
+    return lyra2_specialized(out, outlen, in, inlen, salt, saltlen, m_cost,
+                             PHS_NCOLS, t_cost, sponge_flags);
+}
+
+int
+PHS_with_ctx_sponge(struct lyra2_ctx *ctx, void *out, size_t outlen,
+                    const void *in, size_t inlen, const void *salt,
+                    size_t saltlen, unsigned int t_cost, unsigned int m_cost,
+                    enum lyra2_sponge sponge, unsigned int rho) {
+    int sponge_flags = lyra2_sponge_flags(sponge, rho);
+    if (sponge_flags < 0 || !phs_lengths_fit(outlen, inlen, saltlen)) {
+        return -1;
+    }
+
+    return lyra2_ctx_specialized(ctx, out, outlen, in, inlen, salt, saltlen,
+                                 m_cost, PHS_NCOLS, t_cost, sponge_flags);
+}
+
+int
+PHS_parallel(void *out, size_t outlen, const void *in, size_t inlen,
+             const void *salt, size_t saltlen, unsigned int t_cost,
+             unsigned int m_cost, unsigned int nthreads) {
+    if (!phs_lengths_fit(outlen, inlen, saltlen)) {
+        return -1;
+    }
+
+    return lyra2_parallel_impl(out, outlen, in, inlen, salt, saltlen, m_cost,
+                               PHS_NCOLS, t_cost, nthreads);
+}
+
+int
+PHS_x4(void *const out[LYRA2_X4_LANES], size_t outlen,
+       const void *const in[LYRA2_X4_LANES], const size_t inlen[LYRA2_X4_LANES],
+       const void *const salt[LYRA2_X4_LANES], const size_t saltlen[LYRA2_X4_LANES],
+       unsigned int t_cost, unsigned int m_cost) {
+    char *keys[LYRA2_X4_LANES];
+    const char *pwds[LYRA2_X4_LANES], *salts[LYRA2_X4_LANES];
+    uint32_t pwdlens[LYRA2_X4_LANES], saltlens[LYRA2_X4_LANES];
+    for (unsigned int lane = 0; lane < LYRA2_X4_LANES; lane++) {
+        if (!phs_lengths_fit(outlen, inlen[lane], saltlen[lane])) {
+            return -1;
+        }
+
+        keys[lane] = out[lane];
+        pwds[lane] = in[lane];
+        pwdlens[lane] = inlen[lane];
+        salts[lane] = salt[lane];
+        saltlens[lane] = saltlen[lane];
+    }
+
+    return lyra2_x4_impl(keys, outlen, pwds, pwdlens, salts, saltlens,
+                         m_cost, PHS_NCOLS, t_cost);
+}
+
+static bool
+phs_job(const void *jobs, unsigned int i, struct interleaved_job *job) {
+    const struct PHS_job *phs = (const struct PHS_job *) jobs + i;
+    if (!phs_lengths_fit(phs->outlen, phs->inlen, phs->saltlen)) {
+        return false;
+    }
+
+    *job = (struct interleaved_job) {
+        .key = phs->out, .keylen = phs->outlen,
+        .pwd = phs->in, .pwdlen = phs->inlen,
+        .salt = phs->salt, .saltlen = phs->saltlen,
+        .R = phs->m_cost, .C = PHS_NCOLS, .T = phs->t_cost
+    };
+    return true;
+}
+
+int
+PHS_interleaved(const struct PHS_job *jobs, unsigned int njobs,
+                unsigned int nlanes) {
+    return lyra2_interleaved_impl(jobs, njobs, nlanes, phs_job);
+}
+
+int
+PHS_interleaved_with_ctx(struct lyra2_ctx *const ctx[], unsigned int nlanes,
+                         const struct PHS_job *jobs, unsigned int njobs) {
+    return lyra2_interleaved_ctx_impl(ctx, nlanes, jobs, njobs, phs_job);
+}
+#else
+/*
+ * Run lyra2_ctx_impl with a constant number of columns for the common powers
+ * of two, so that each of them gets its own copy of Lyra2 with fixed bounds
+ * on the column loops and masks for the column indices, as the PHS functions
+ * get for PHS_NCOLS. Other column counts take the generic copy.
+ */
+static int
+lyra2_ctx_columns(struct lyra2_ctx *ctx, char *key, uint32_t keylen,
+                  const char *pwd, uint32_t pwdlen, const char *salt,
+                  uint32_t saltlen, uint32_t R, uint32_t C, uint32_t T) {
+#define SPECIALIZE(ncols)                                                   \
+    case ncols:                                                             \
+        return lyra2_ctx_impl(ctx, key, keylen, pwd, pwdlen, salt, saltlen, \
+                              R, ncols, T, 0);
+
+    switch (C) {
+    SPECIALIZE(16)
+    SPECIALIZE(32)
+    SPECIALIZE(64)
+    SPECIALIZE(128)
+    SPECIALIZE(256)
+    SPECIALIZE(512)
+    SPECIALIZE(1024)
+    }
+
+#undef SPECIALIZE
+    return lyra2_ctx_impl(ctx, key, keylen, pwd, pwdlen, salt, saltlen, R, C,
+                          T, 0);
+}
+
+int
+lyra2(char *key, uint32_t keylen, const char *pwd, uint32_t pwdlen,
+      const char *salt, uint32_t saltlen, uint32_t R, uint32_t C,
+      uint32_t T) {
+    struct lyra2_ctx ctx;
+    if (!costs_valid(R, C, T) || !lyra2_ctx_init(&ctx, R, C)) {
+        return -1;
+    }
+
+    int ret = lyra2_ctx_columns(&ctx, key, keylen, pwd, pwdlen, salt, saltlen,
+                                R, C, T);
+    lyra2_ctx_destroy(&ctx);
+    return ret;
+}
+
+int
+lyra2_with_ctx(struct lyra2_ctx *ctx, char *key, uint32_t keylen,
+               const char *pwd, uint32_t pwdlen, const char *salt,
+               uint32_t saltlen, uint32_t R, uint32_t C, uint32_t T) {
+    return lyra2_ctx_columns(ctx, key, keylen, pwd, pwdlen, salt, saltlen, R,
+                             C, T);
+}
+
+int
+lyra2_with_sponge(char *key, uint32_t keylen, const char *pwd,
+                  uint32_t pwdlen, const char *salt, uint32_t saltlen,
+                  uint32_t R, uint32_t C, uint32_t T,
+                  enum lyra2_sponge sponge, unsigned int rho) {
+    int sponge_flags = lyra2_sponge_flags(sponge, rho);
+    if (sponge_flags < 0) {
+        return -1;
+    }
+
+    return lyra2_specialized(key, keylen, pwd, pwdlen, salt, saltlen, R, C, T,
+                             sponge_flags);
+}
+
+int
+lyra2_with_ctx_sponge(struct lyra2_ctx *ctx, char *key, uint32_t keylen,
+                      const char *pwd, uint32_t pwdlen, const char *salt,
+                      uint32_t saltlen, uint32_t R, uint32_t C, uint32_t T,
+                      enum lyra2_sponge sponge, unsigned int rho) {
+    int sponge_flags = lyra2_sponge_flags(sponge, rho);
+    if (sponge_flags < 0) {
+        return -1;
+    }
+
+    return lyra2_ctx_specialized(ctx, key, keylen, pwd, pwdlen, salt, saltlen,
+                                 R, C, T, sponge_flags);
+}
+
+int
+lyra2_parallel(char *key, uint32_t keylen, const char *pwd, uint32_t pwdlen,
+               const char *salt, uint32_t saltlen, uint32_t R, uint32_t C,
+               uint32_t T, unsigned int nthreads) {
+    return lyra2_parallel_impl(key, keylen, pwd, pwdlen, salt, saltlen, R, C,
+                               T, nthreads);
+}
+
+int
+lyra2_x4(char *const key[LYRA2_X4_LANES], uint32_t keylen,
+         const char *const pwd[LYRA2_X4_LANES], const uint32_t pwdlen[LYRA2_X4_LANES],
+         const char *const salt[LYRA2_X4_LANES], const uint32_t saltlen[LYRA2_X4_LANES],
+         uint32_t R, uint32_t C, uint32_t T) {
+    return lyra2_x4_impl(key, keylen, pwd, pwdlen, salt, saltlen, R, C, T);
+}
+
+static bool
+lyra2_job(const void *jobs, unsigned int i, struct interleaved_job *job) {
+    const struct lyra2_job *j = (const struct lyra2_job *) jobs + i;
+    *job = (struct interleaved_job) {
+        .key = j->key, .keylen = j->keylen,
+        .pwd = j->pwd, .pwdlen = j->pwdlen,
+        .salt = j->salt, .saltlen = j->saltlen,
+        .R = j->R, .C = j->C, .T = j->T
+    };
+    return true;
+}
+
+int
+lyra2_interleaved(const struct lyra2_job *jobs, unsigned int njobs,
+                  unsigned int nlanes) {
+    return lyra2_interleaved_impl(jobs, njobs, nlanes, lyra2_job);
+}
+
+int
+lyra2_interleaved_with_ctx(struct lyra2_ctx *const ctx[], unsigned int nlanes,
+                           const struct lyra2_job *jobs, unsigned int njobs) {
+    return lyra2_interleaved_ctx_impl(ctx, nlanes, jobs, njobs, lyra2_job);
 }
 #endif
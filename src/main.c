@@ -4,9 +4,51 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
 #include <sys/time.h>
 
+#ifndef NMEASUREMENTS
+#ifdef BENCH_LARGE
+#define NMEASUREMENTS 3
+#else
 #define NMEASUREMENTS 1000
+#endif
+#endif
+
+#if defined(BENCH_BLAMKA) || defined(BENCH_RHO)
+#ifdef BENCH_BLAMKA
+#define BENCH_SPONGE LYRA2_SPONGE_BLAMKA
+#else
+#define BENCH_SPONGE LYRA2_SPONGE_BLAKE2B
+#endif
+#ifndef BENCH_RHO
+#define BENCH_RHO 0
+#endif
+#endif
+
+#if defined(BENCH_X4) && defined(BENCH_SPONGE)
+#error "The multi-buffer functions only support the default sponge"
+#endif
+
+#if defined(BENCH_THREADS) && (defined(BENCH_X4) || defined(BENCH_SPONGE))
+#error "The parallel functions only support the default sponge, one key at a time"
+#endif
+
+#if defined(BENCH_CTX) && (defined(BENCH_X4) || defined(BENCH_SPONGE) || defined(BENCH_THREADS))
+#error "The context functions only support the default sponge, one key at a time"
+#endif
+
+#if defined(BENCH_INTERLEAVE) && (defined(BENCH_X4) || defined(BENCH_SPONGE) || defined(BENCH_THREADS) || defined(BENCH_CTX))
+#error "The interleaved functions only support the default sponge, and use their own contexts"
+#endif
+
+#if defined(BENCH_X4)
+#define BENCH_KEYS LYRA2_X4_LANES
+#elif defined(BENCH_INTERLEAVE)
+#define BENCH_KEYS BENCH_INTERLEAVE
+#else
+#define BENCH_KEYS 1
+#endif
 
 int
 cmp(const void *xv, const void *yv) {
@@ -19,11 +61,18 @@ struct lyra2_parameters {
     unsigned int R, T, C;
 };
 
+#ifdef BENCH_LARGE
+// a 3 GiB matrix, whose size no longer fits in 32 bits
+struct lyra2_parameters params[] = {
+    {131072, 1, 256}
+};
+#else
 struct lyra2_parameters params[] = {
     { 16,  16,  64},
     { 32,  32, 128},
     { 64,  64, 128}
 };
+#endif
 
 float
 compute_standard_deviation(unsigned long *values) {
@@ -42,18 +91,99 @@ main(void) {
     char key[64] = {0};
     char *pwd = "Lyra sponge";
     char *salt = "saltsaltsaltsalt";
+#if defined(BENCH_X4) || defined(BENCH_INTERLEAVE)
+    size_t pwdlen = strlen(pwd), saltlen = strlen(salt);
+#endif
 
     printf("Input:\n  Password: '%s'\n  Salt: '%s'\n\n", pwd, salt);
     for (unsigned int i = 0; i < sizeof(params) / sizeof(params[0]); i++) {
         unsigned long results[NMEASUREMENTS] = {0};
+#if defined(BENCH_CTX) && defined(USE_PHS_INTERFACE)
+        struct lyra2_ctx *ctx = lyra2_ctx_new(params[i].R, PHS_NCOLS);
+#elif defined(BENCH_CTX)
+        struct lyra2_ctx *ctx = lyra2_ctx_new(params[i].R, params[i].C);
+#elif defined(BENCH_INTERLEAVE)
+        struct lyra2_ctx *ctx[BENCH_INTERLEAVE];
+#ifdef USE_PHS_INTERFACE
+        struct PHS_job jobs[BENCH_INTERLEAVE];
+#else
+        struct lyra2_job jobs[BENCH_INTERLEAVE];
+#endif
+        for (unsigned int k = 0; k < BENCH_INTERLEAVE; k++) {
+#ifdef USE_PHS_INTERFACE
+            ctx[k] = lyra2_ctx_new(params[i].R, PHS_NCOLS);
+            jobs[k] = (struct PHS_job) {
+                key, sizeof(key), pwd, pwdlen, salt, saltlen,
+                params[i].T, params[i].R
+            };
+#else
+            ctx[k] = lyra2_ctx_new(params[i].R, params[i].C);
+            jobs[k] = (struct lyra2_job) {
+                key, sizeof(key), pwd, pwdlen, salt, saltlen,
+                params[i].R, params[i].C, params[i].T
+            };
+#endif
+        }
+#endif
+        // page faults taken during the measurements, which getrusage counts
+        // for the whole process
+        unsigned long minflt = 0, majflt = 0;
         for (int j = 0; j < NMEASUREMENTS; j++) {
+            struct rusage u0, u1;
+            getrusage(RUSAGE_SELF, &u0);
+
             struct timeval t0;
             struct timeval t1;
             gettimeofday(&t0, 0);
 
-#ifdef USE_PHS_INTERFACE
+#if defined(BENCH_X4) && defined(USE_PHS_INTERFACE)
+            void *keys[] = {key, key, key, key};
+            const void *pwds[] = {pwd, pwd, pwd, pwd};
+            const void *salts[] = {salt, salt, salt, salt};
+            const size_t pwdlens[] = {pwdlen, pwdlen, pwdlen, pwdlen};
+            const size_t saltlens[] = {saltlen, saltlen, saltlen, saltlen};
+            PHS_x4(keys, sizeof(key), pwds, pwdlens, salts, saltlens,
+                   params[i].T, params[i].R);
+#elif defined(BENCH_X4)
+            char *keys[] = {key, key, key, key};
+            const char *pwds[] = {pwd, pwd, pwd, pwd};
+            const char *salts[] = {salt, salt, salt, salt};
+            const uint32_t pwdlens[] = {pwdlen, pwdlen, pwdlen, pwdlen};
+            const uint32_t saltlens[] = {saltlen, saltlen, saltlen, saltlen};
+            lyra2_x4(keys, sizeof(key), pwds, pwdlens, salts, saltlens,
+                     params[i].R, params[i].C, params[i].T);
+#elif defined(BENCH_CTX) && defined(USE_PHS_INTERFACE)
+            PHS_with_ctx(ctx, key, sizeof(key), pwd, strlen(pwd), salt,
+                         strlen(salt), params[i].T, params[i].R);
+#elif defined(BENCH_CTX)
+            lyra2_with_ctx(ctx, key, sizeof(key), pwd, strlen(pwd), salt,
+                           strlen(salt), params[i].R, params[i].C,
+                           params[i].T);
+#elif defined(BENCH_INTERLEAVE) && defined(USE_PHS_INTERFACE)
+            PHS_interleaved_with_ctx(ctx, BENCH_INTERLEAVE, jobs,
+                                     BENCH_INTERLEAVE);
+#elif defined(BENCH_INTERLEAVE)
+            lyra2_interleaved_with_ctx(ctx, BENCH_INTERLEAVE, jobs,
+                                       BENCH_INTERLEAVE);
+#elif defined(BENCH_THREADS) && defined(USE_PHS_INTERFACE)
+            PHS_parallel(key, sizeof(key), pwd, strlen(pwd), salt,
+                         strlen(salt), params[i].T, params[i].R,
+                         BENCH_THREADS);
+#elif defined(BENCH_THREADS)
+            lyra2_parallel(key, sizeof(key), pwd, strlen(pwd), salt,
+                           strlen(salt), params[i].R, params[i].C,
+                           params[i].T, BENCH_THREADS);
+#elif defined(BENCH_SPONGE) && defined(USE_PHS_INTERFACE)
+            PHS_with_sponge(key, sizeof(key), pwd, strlen(pwd), salt,
+                            strlen(salt), params[i].T, params[i].R,
+                            BENCH_SPONGE, BENCH_RHO);
+#elif defined(BENCH_SPONGE)
+            lyra2_with_sponge(key, sizeof(key), pwd, strlen(pwd), salt,
+                              strlen(salt), params[i].R, params[i].C,
+                              params[i].T, BENCH_SPONGE, BENCH_RHO);
+#elif defined(USE_PHS_INTERFACE)
             PHS(key, sizeof(key), pwd, strlen(pwd), salt, strlen(salt),
-                params[i].R, params[i].T);
+                params[i].T, params[i].R);
 #else
             lyra2(key, sizeof(key), pwd, strlen(pwd), salt, strlen(salt),
                   params[i].R, params[i].C, params[i].T);
@@ -61,7 +191,21 @@ main(void) {
 
             gettimeofday(&t1, 0);
             results[j] = (t1.tv_sec - t0.tv_sec) * 1000000 + t1.tv_usec - t0.tv_usec;
+
+            getrusage(RUSAGE_SELF, &u1);
+            minflt += u1.ru_minflt - u0.ru_minflt;
+            majflt += u1.ru_majflt - u0.ru_majflt;
+            // report the time per derived key, so that results are comparable
+            // with single-key builds
+            results[j] /= BENCH_KEYS;
         }
+#ifdef BENCH_CTX
+        lyra2_ctx_free(ctx);
+#elif defined(BENCH_INTERLEAVE)
+        for (unsigned int k = 0; k < BENCH_INTERLEAVE; k++) {
+            lyra2_ctx_free(ctx[k]);
+        }
+#endif
 
 #ifdef USE_PHS_INTERFACE
         printf("Parameters: R = %u, C = %u, T = %u\n",
@@ -80,6 +224,22 @@ main(void) {
         printf("Median time: %lu us\n", results[NMEASUREMENTS/2]);
         printf("Standard deviation: %.2f us\n",
                compute_standard_deviation(results));
+        // The reports below go to stderr, so that benchmark.py can compare
+        // builds that differ in them.
+        const float nhashes = NMEASUREMENTS * BENCH_KEYS;
+        fprintf(stderr, "Page faults per hash: %.2f minor, %.2f major\n",
+                minflt / nhashes, majflt / nhashes);
+#ifdef LYRA2_HUGEPAGES
+        fprintf(stderr, "Matrix backing: %s\n",
+                lyra2_backing_name(lyra2_matrix_backing()));
+#endif
+#ifdef LYRA2_MLOCK
+        fprintf(stderr, "Matrix locked: %s\n",
+                lyra2_matrix_locked() ? "yes" : "no");
+#endif
+#ifdef LYRA2_NUMA
+        fprintf(stderr, "Matrix node: %d\n", lyra2_matrix_node());
+#endif
         printf("\n");
     }
 
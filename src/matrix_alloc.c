@@ -0,0 +1,313 @@
+#define _GNU_SOURCE
+
+#include "matrix_alloc.h"
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <sys/mman.h>
+
+#if defined(LYRA2_PREFAULT) || defined(LYRA2_NUMA)
+#include <unistd.h>
+#endif
+
+#ifdef LYRA2_NUMA
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#endif
+
+// the backing of the most recently allocated matrix, for lyra2_matrix_backing
+static enum lyra2_backing last_backing = LYRA2_BACKING_NONE;
+
+// whether the most recently allocated matrix is locked, for lyra2_matrix_locked
+static bool last_locked = false;
+
+// the NUMA node of the most recently allocated matrix, for lyra2_matrix_node
+static int last_node = -1;
+
+#if defined(LYRA2_PREFAULT) && defined(MAP_POPULATE)
+#define LYRA2_MAP_POPULATE MAP_POPULATE
+#else
+#define LYRA2_MAP_POPULATE 0
+#endif
+
+#ifdef LYRA2_HUGEPAGES
+static size_t
+hugepage_round_up(size_t size) {
+    return (size + LYRA2_HUGEPAGE_SIZE - 1) & ~((size_t) LYRA2_HUGEPAGE_SIZE - 1);
+}
+
+static void *
+map_hugepages(size_t size, enum lyra2_backing *backing) {
+    const size_t length = hugepage_round_up(size);
+
+#ifdef MAP_HUGETLB
+    void *pages = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB |
+                       LYRA2_MAP_POPULATE, -1, 0);
+    if (pages != MAP_FAILED) {
+        *backing = LYRA2_BACKING_HUGETLB;
+        return pages;
+    }
+#endif
+
+#ifdef MADV_HUGEPAGE
+    // Map an extra huge page and trim the region around the first huge page
+    // boundary in it, since the kernel can only back aligned ranges with
+    // transparent huge pages.
+    uint8_t *region = mmap(NULL, length + LYRA2_HUGEPAGE_SIZE,
+                           PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+        return NULL;
+    }
+
+    uint8_t *start = (uint8_t *) hugepage_round_up((uintptr_t) region);
+    size_t head = start - region;
+    if (head) {
+        munmap(region, head);
+    }
+    munmap(start + length, LYRA2_HUGEPAGE_SIZE - head);
+
+    if (madvise(start, length, MADV_HUGEPAGE) == 0) {
+        *backing = LYRA2_BACKING_THP;
+        return start;
+    }
+
+    munmap(start, length);
+#endif
+
+    return NULL;
+}
+#endif
+
+#ifdef LYRA2_NUMA
+#ifndef LYRA2_NUMA_MAX_NODES
+#define LYRA2_NUMA_MAX_NODES 1024
+#endif
+
+#define NODEMASK_BITS (CHAR_BIT * sizeof(unsigned long))
+
+/*
+ * Whether the process may allocate memory from more than one NUMA node, which
+ * is checked once: on a single node a placement policy changes nothing, but
+ * still costs its system call and keeps the kernel from faulting in more than
+ * one page at a time.
+ */
+static bool
+numa_multinode(void) {
+    // 0 until checked, then 1 or 2 nodes (or more)
+    static int nnodes = 0;
+
+    int n = __atomic_load_n(&nnodes, __ATOMIC_RELAXED);
+    if (!n) {
+        unsigned long allowed[LYRA2_NUMA_MAX_NODES / NODEMASK_BITS] = {0};
+        n = 1;
+        if (syscall(SYS_get_mempolicy, NULL, allowed, LYRA2_NUMA_MAX_NODES + 1,
+                    NULL, MPOL_F_MEMS_ALLOWED) == 0) {
+            unsigned int bits = 0;
+            for (unsigned int i = 0; i < LYRA2_NUMA_MAX_NODES / NODEMASK_BITS; i++) {
+                bits += __builtin_popcountl(allowed[i]);
+            }
+            n = bits > 1 ? 2 : 1;
+        }
+
+        __atomic_store_n(&nnodes, n, __ATOMIC_RELAXED);
+    }
+
+    return n > 1;
+}
+
+/*
+ * Have the kernel place the pages at |ptr| on the NUMA node of the CPU the
+ * calling thread runs on, moving those it has already placed elsewhere. The
+ * policy is only a preference, so allocation falls back to other nodes when
+ * the local one is full. Libnuma is just a wrapper around these two system
+ * calls.
+ */
+int
+lyra2_matrix_bind_local(void *ptr, size_t size) {
+    unsigned int cpu, node;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) || node >= LYRA2_NUMA_MAX_NODES) {
+        return -1;
+    }
+
+    if (!numa_multinode()) {
+        return node;
+    }
+
+    // only the pages entirely within the range, which may be shared with
+    // other threads' ranges otherwise
+    const uintptr_t page = sysconf(_SC_PAGESIZE);
+    uintptr_t start = ((uintptr_t) ptr + page - 1) & ~(page - 1);
+    uintptr_t end = ((uintptr_t) ptr + size) & ~(page - 1);
+    if (start >= end) {
+        return node;
+    }
+
+    unsigned long nodemask[LYRA2_NUMA_MAX_NODES / NODEMASK_BITS] = {0};
+    nodemask[node / NODEMASK_BITS] = 1UL << (node % NODEMASK_BITS);
+
+    // the kernel reads one bit less than maxnode
+    if (syscall(SYS_mbind, start, end - start, MPOL_PREFERRED, nodemask,
+                LYRA2_NUMA_MAX_NODES + 1, MPOL_MF_MOVE)) {
+        return -1;
+    }
+
+    return node;
+}
+#else
+int
+lyra2_matrix_bind_local(void *ptr, size_t size) {
+    (void) ptr;
+    (void) size;
+    return -1;
+}
+#endif
+
+#ifdef LYRA2_PREFAULT
+/*
+ * Write to every page of the matrix, so that the kernel maps all of them now
+ * rather than on first use by the setup and filling phases. The contents are
+ * overwritten by those phases anyway.
+ */
+static void
+prefault(void *ptr, size_t size) {
+    const size_t page = sysconf(_SC_PAGESIZE);
+    volatile uint8_t *bytes = ptr;
+    for (size_t offset = 0; offset < size; offset += page) {
+        bytes[offset] = 0;
+    }
+
+    if (size) {
+        bytes[size - 1] = 0;
+    }
+}
+#endif
+
+void *
+lyra2_matrix_alloc(size_t size, size_t alignment, enum lyra2_backing *backing) {
+    void *ptr = NULL;
+
+#ifdef LYRA2_HUGEPAGES
+    if (size >= LYRA2_HUGEPAGE_SIZE) {
+        ptr = map_hugepages(size, backing);
+    }
+#endif
+
+    if (!ptr && size >= LYRA2_MMAP_THRESHOLD) {
+        void *pages = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | LYRA2_MAP_POPULATE,
+                           -1, 0);
+        if (pages != MAP_FAILED) {
+            ptr = pages;
+            *backing = LYRA2_BACKING_MMAP;
+        }
+    }
+
+    if (!ptr) {
+        if (alignment < sizeof(void *)) {
+            alignment = sizeof(void *);
+        }
+
+#ifdef LYRA2_NUMA
+        // So that lyra2_matrix_bind_local covers the whole matrix. glibc
+        // does not reuse large page-aligned blocks between calls, so only
+        // when there is a placement to make.
+        if (numa_multinode() && alignment < (size_t) sysconf(_SC_PAGESIZE)) {
+            alignment = sysconf(_SC_PAGESIZE);
+        }
+#endif
+
+        if (posix_memalign(&ptr, alignment, size)) {
+            return NULL;
+        }
+        *backing = LYRA2_BACKING_HEAP;
+    }
+
+    int node = -1;
+#ifdef LYRA2_NUMA
+    // before faulting anything in, so that the pages go straight to the node
+    node = lyra2_matrix_bind_local(ptr, size);
+#endif
+
+#ifdef LYRA2_PREFAULT
+    // hugetlb and plain mappings were already populated by mmap
+    if ((*backing != LYRA2_BACKING_HUGETLB && *backing != LYRA2_BACKING_MMAP) ||
+        !LYRA2_MAP_POPULATE) {
+        prefault(ptr, size);
+    }
+#endif
+
+    bool locked = false;
+#ifdef LYRA2_MLOCK
+    // Locking faults the pages in as well. It fails past RLIMIT_MEMLOCK,
+    // in which case the matrix is simply left unlocked.
+    locked = mlock(ptr, size) == 0;
+#endif
+
+    __atomic_store_n(&last_backing, *backing, __ATOMIC_RELAXED);
+    __atomic_store_n(&last_locked, locked, __ATOMIC_RELAXED);
+    __atomic_store_n(&last_node, node, __ATOMIC_RELAXED);
+    return ptr;
+}
+
+void
+lyra2_matrix_free(void *ptr, size_t size, enum lyra2_backing backing) {
+#ifdef LYRA2_MLOCK
+    // a no-op if locking failed, and needed for memory going back to the heap
+    munlock(ptr, size);
+#endif
+
+    switch (backing) {
+    case LYRA2_BACKING_HEAP:
+        free(ptr);
+        break;
+    case LYRA2_BACKING_MMAP:
+        munmap(ptr, size);
+        break;
+#ifdef LYRA2_HUGEPAGES
+    case LYRA2_BACKING_HUGETLB:
+    case LYRA2_BACKING_THP:
+        munmap(ptr, hugepage_round_up(size));
+        break;
+#endif
+    default:
+        break;
+    }
+}
+
+enum lyra2_backing
+lyra2_matrix_backing(void) {
+    return __atomic_load_n(&last_backing, __ATOMIC_RELAXED);
+}
+
+int
+lyra2_matrix_locked(void) {
+    return __atomic_load_n(&last_locked, __ATOMIC_RELAXED);
+}
+
+int
+lyra2_matrix_node(void) {
+    return __atomic_load_n(&last_node, __ATOMIC_RELAXED);
+}
+
+const char *
+lyra2_backing_name(enum lyra2_backing backing) {
+    switch (backing) {
+    case LYRA2_BACKING_HEAP:
+        return "heap";
+    case LYRA2_BACKING_HUGETLB:
+        return "hugetlb";
+    case LYRA2_BACKING_THP:
+        return "transparent huge pages";
+    case LYRA2_BACKING_MMAP:
+        return "anonymous mapping";
+    case LYRA2_BACKING_NONE:
+        break;
+    }
+
+    return "none";
+}
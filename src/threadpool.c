@@ -0,0 +1,104 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "threadpool.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+static struct {
+    // held for the whole of a job, so that only one runs at a time
+    pthread_mutex_t run_lock;
+
+    // protects the fields below
+    pthread_mutex_t lock;
+    pthread_cond_t wake, done;
+
+    unsigned int nworkers;
+
+    // the current job; a new one is announced by bumping the generation
+    uint64_t generation;
+    unsigned int nthreads, pending;
+    lyra2_pool_fn fn;
+    void *arg;
+} pool = {
+    .run_lock = PTHREAD_MUTEX_INITIALIZER,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+static void *
+pool_worker(void *arg) {
+    const unsigned int thread = (uintptr_t) arg;
+
+    pthread_mutex_lock(&pool.lock);
+    // Workers are only created for a job that needs them, and that job cannot
+    // finish without them, so it is still the current one.
+    uint64_t seen = pool.generation - 1;
+
+    for (;;) {
+        while (pool.generation == seen) {
+            pthread_cond_wait(&pool.wake, &pool.lock);
+        }
+
+        seen = pool.generation;
+        if (thread >= pool.nthreads) {
+            continue;
+        }
+
+        lyra2_pool_fn fn = pool.fn;
+        void *fn_arg = pool.arg;
+        pthread_mutex_unlock(&pool.lock);
+        fn(fn_arg, thread);
+        pthread_mutex_lock(&pool.lock);
+
+        if (--pool.pending == 0) {
+            pthread_cond_signal(&pool.done);
+        }
+    }
+
+    return NULL;
+}
+
+int
+lyra2_pool_run(unsigned int nthreads, lyra2_pool_fn fn, void *arg) {
+    pthread_mutex_lock(&pool.run_lock);
+    pthread_mutex_lock(&pool.lock);
+
+    while (pool.nworkers + 1 < nthreads) {
+        pthread_t worker;
+        if (pthread_create(&worker, NULL, pool_worker,
+                           (void *) (uintptr_t) (pool.nworkers + 1))) {
+            pthread_mutex_unlock(&pool.lock);
+            pthread_mutex_unlock(&pool.run_lock);
+            return -1;
+        }
+
+        pthread_detach(worker);
+        pool.nworkers++;
+    }
+
+    pool.fn = fn;
+    pool.arg = arg;
+    pool.nthreads = nthreads;
+    pool.pending = nthreads - 1;
+    pool.generation++;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    fn(arg, 0);
+
+    pthread_mutex_lock(&pool.lock);
+    while (pool.pending) {
+        pthread_cond_wait(&pool.done, &pool.lock);
+    }
+    pthread_mutex_unlock(&pool.lock);
+
+    pthread_mutex_unlock(&pool.run_lock);
+    return 0;
+}
+
+void
+lyra2_pool_yield(void) {
+    sched_yield();
+}
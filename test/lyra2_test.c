@@ -0,0 +1,631 @@
+#line 1 "test/lyra2_test.check"
+#include "lyra2.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#define START_TEST(n) static void n(void)
+#define END_TEST
+
+#include <assert.h>
+#define ck_assert assert
+
+/*
+ * The tests call the library through wrappers with the arguments of lyra2,
+ * so that they run against either interface; with the PHS one, C is always
+ * PHS_NCOLS.
+ */
+#ifdef USE_PHS_INTERFACE
+#define NCOLS(C) PHS_NCOLS
+#define HASH_FN(suffix) PHS##suffix
+#define GEN_HASH(name, fn)                                                 \
+    static int                                                             \
+    name(char *key, uint32_t keylen, const char *pwd, const char *salt,    \
+         uint32_t R, uint32_t C, uint32_t T) {                             \
+        (void) C;                                                          \
+        return fn(key, keylen, pwd, strlen(pwd), salt, strlen(salt), T, R); \
+    }
+#else
+#define NCOLS(C) (C)
+#define HASH_FN(suffix) lyra2##suffix
+#define GEN_HASH(name, fn)                                                 \
+    static int                                                             \
+    name(char *key, uint32_t keylen, const char *pwd, const char *salt,    \
+         uint32_t R, uint32_t C, uint32_t T) {                             \
+        return fn(key, keylen, pwd, strlen(pwd), salt, strlen(salt),       \
+                  R, C, T);                                                \
+    }
+#endif
+
+GEN_HASH(hash, HASH_FN())
+
+static int
+hash_with_ctx(struct lyra2_ctx *ctx, char *key, uint32_t keylen,
+              const char *pwd, const char *salt, uint32_t R, uint32_t C,
+              uint32_t T) {
+#ifdef USE_PHS_INTERFACE
+    (void) C;
+    return PHS_with_ctx(ctx, key, keylen, pwd, strlen(pwd), salt,
+                        strlen(salt), T, R);
+#else
+    return lyra2_with_ctx(ctx, key, keylen, pwd, strlen(pwd), salt,
+                          strlen(salt), R, C, T);
+#endif
+}
+
+static int
+hash_with_sponge(char *key, uint32_t keylen, const char *pwd,
+                 const char *salt, uint32_t R, uint32_t C, uint32_t T,
+                 enum lyra2_sponge sponge, unsigned int rho) {
+#ifdef USE_PHS_INTERFACE
+    (void) C;
+    return PHS_with_sponge(key, keylen, pwd, strlen(pwd), salt, strlen(salt),
+                           T, R, sponge, rho);
+#else
+    return lyra2_with_sponge(key, keylen, pwd, strlen(pwd), salt,
+                             strlen(salt), R, C, T, sponge, rho);
+#endif
+}
+
+static int
+hash_parallel(char *key, uint32_t keylen, const char *pwd, const char *salt,
+              uint32_t R, uint32_t C, uint32_t T, unsigned int nthreads) {
+#ifdef USE_PHS_INTERFACE
+    (void) C;
+    return PHS_parallel(key, keylen, pwd, strlen(pwd), salt, strlen(salt),
+                        T, R, nthreads);
+#else
+    return lyra2_parallel(key, keylen, pwd, strlen(pwd), salt, strlen(salt),
+                          R, C, T, nthreads);
+#endif
+}
+
+static int
+hash_x4(char *const key[LYRA2_X4_LANES], uint32_t keylen,
+        const char *const pwd[LYRA2_X4_LANES],
+        const char *const salt[LYRA2_X4_LANES], uint32_t R, uint32_t C,
+        uint32_t T) {
+#ifdef USE_PHS_INTERFACE
+    void *out[LYRA2_X4_LANES];
+    const void *in[LYRA2_X4_LANES], *salts[LYRA2_X4_LANES];
+    size_t pwdlen[LYRA2_X4_LANES], saltlen[LYRA2_X4_LANES];
+#else
+    uint32_t pwdlen[LYRA2_X4_LANES], saltlen[LYRA2_X4_LANES];
+#endif
+    for (unsigned int lane = 0; lane < LYRA2_X4_LANES; lane++) {
+        pwdlen[lane] = strlen(pwd[lane]);
+        saltlen[lane] = strlen(salt[lane]);
+#ifdef USE_PHS_INTERFACE
+        out[lane] = key[lane];
+        in[lane] = pwd[lane];
+        salts[lane] = salt[lane];
+#endif
+    }
+
+#ifdef USE_PHS_INTERFACE
+    (void) C;
+    return PHS_x4(out, keylen, in, pwdlen, salts, saltlen, T, R);
+#else
+    return lyra2_x4(key, keylen, pwd, pwdlen, salt, saltlen, R, C, T);
+#endif
+}
+
+#ifdef USE_PHS_INTERFACE
+typedef struct PHS_job job_t;
+#else
+typedef struct lyra2_job job_t;
+#endif
+
+static job_t
+make_job(char *key, uint32_t keylen, const char *pwd, const char *salt,
+         uint32_t R, uint32_t C, uint32_t T) {
+#ifdef USE_PHS_INTERFACE
+    (void) C;
+    return (job_t) {
+        .out = key, .outlen = keylen, .in = pwd, .inlen = strlen(pwd),
+        .salt = salt, .saltlen = strlen(salt), .t_cost = T, .m_cost = R,
+    };
+#else
+    return (job_t) {
+        .key = key, .keylen = keylen, .pwd = pwd, .pwdlen = strlen(pwd),
+        .salt = salt, .saltlen = strlen(salt), .R = R, .C = C, .T = T,
+    };
+#endif
+}
+
+#define hash_interleaved HASH_FN(_interleaved)
+#define hash_interleaved_with_ctx HASH_FN(_interleaved_with_ctx)
+
+/*
+ * Costs covering a single wandering pass, row counts that are and aren't
+ * powers of two, and rows of a single block; with the PHS interface, only
+ * PHS_NCOLS columns.
+ */
+static const uint32_t Rs[] = { 3, 4, 8, 17 };
+#ifdef USE_PHS_INTERFACE
+static const uint32_t Cs[] = { PHS_NCOLS };
+#else
+static const uint32_t Cs[] = { 1, 3, 16, 256 };
+#endif
+static const uint32_t Ts[] = { 1, 2, 3 };
+
+#define NELEMS(a) (sizeof(a) / sizeof((a)[0]))
+#define NCOSTS (NELEMS(Rs) * NELEMS(Cs) * NELEMS(Ts))
+#define MAX_R 17
+#define MAX_C NCOLS(256)
+
+static const char *const pwds[] = {
+    "password", "Lyra sponge", "",
+    "a password long enough to span a few blocks of the sponge's rate, "
+    "so that absorbing it takes more than one compression",
+    "x",
+};
+
+static const char *const salts[] = {
+    "salt", "saltsaltsaltsalt", "pepper", "s", "another salt",
+};
+
+#define NINPUTS NELEMS(pwds)
+
+/*
+ * The known answers below depend on the width Rt of the block rotations (see
+ * src/lyra2.c), which is 128 bits, as in the reference implementation, unless
+ * the build uses AVX2 words without LYRA2_ROT_BITS. They are for the default
+ * block length, number of rounds and PHS_NCOLS.
+ */
+#include "blake2b/blake2-config.h"
+
+#if defined(LYRA2_ROT_BITS)
+#define RT_BITS LYRA2_ROT_BITS
+#elif defined(HAVE_AVX2) && !defined(SPONGE_PORTABLE)
+#define RT_BITS 256
+#else
+#define RT_BITS 128
+#endif
+
+#if LYRA2_BLOCK_WORDS == 12 && NCOLS(256) == 256 && \
+    !defined(SPONGE_FULL_ROUNDS) && !defined(SPONGE_REDUCED_ROUNDS) && \
+    (RT_BITS == 128 || RT_BITS == 256)
+#define HAVE_KNOWN_ANSWERS
+#endif
+
+/*
+ * The per-ISA copies of the DISPATCH build (see src/dispatch.c), with whether
+ * this CPU can run them.
+ */
+#ifdef LYRA2_DISPATCH
+#define DECLARE_ISA(isa)                         \
+    __typeof__(HASH_FN()) HASH_FN(_##isa);       \
+    GEN_HASH(hash_##isa, HASH_FN(_##isa))
+
+DECLARE_ISA(sse2)
+DECLARE_ISA(ssse3)
+DECLARE_ISA(avx2)
+DECLARE_ISA(avx512)
+
+static bool
+isa_sse2_supported(void) {
+    return __builtin_cpu_supports("sse2");
+}
+
+static bool
+isa_ssse3_supported(void) {
+    return __builtin_cpu_supports("ssse3") && __builtin_cpu_supports("sse4.1");
+}
+
+static bool
+isa_avx2_supported(void) {
+    return __builtin_cpu_supports("avx2");
+}
+
+static bool
+isa_avx512_supported(void) {
+    return isa_avx2_supported() && __builtin_cpu_supports("avx512f") &&
+        __builtin_cpu_supports("avx512vl");
+}
+
+static const struct {
+    const char *name;
+    bool (*supported)(void);
+    __typeof__(hash) *hash;
+} isas[] = {
+    { "sse2", isa_sse2_supported, hash_sse2 },
+    { "ssse3", isa_ssse3_supported, hash_ssse3 },
+    { "avx2", isa_avx2_supported, hash_avx2 },
+    { "avx512", isa_avx512_supported, hash_avx512 },
+};
+#endif
+
+// key lengths that end partway through 128- and 256-bit sponge words
+static const uint32_t keylens[] = { 1, 17, 32, 33, 48, 56, 64, 100 };
+
+START_TEST(key_tail)
+{
+#line 239
+    // every byte of the key must be written, whatever the length: deriving
+    // it into buffers filled with different values must give the same key
+    for (unsigned int k = 0; k < sizeof(keylens) / sizeof(keylens[0]); k++) {
+        char zeros[128], ones[128];
+        memset(zeros, 0x00, sizeof(zeros));
+        memset(ones, 0xff, sizeof(ones));
+
+        ck_assert(hash(zeros, keylens[k], "password", "salt", 8, 16, 1) == 0);
+        ck_assert(hash(ones, keylens[k], "password", "salt", 8, 16, 1) == 0);
+        ck_assert(!memcmp(zeros, ones, keylens[k]));
+
+        // and nothing past it
+        for (unsigned int i = keylens[k]; i < sizeof(zeros); i++) {
+            ck_assert(zeros[i] == 0x00 && ones[i] == (char) 0xff);
+        }
+    }
+    return;
+
+}
+END_TEST
+
+START_TEST(dispatch_isas_agree)
+{
+#line 258
+    // all ISA copies of the DISPATCH build must derive the same keys as the
+    // SSE2 one, including those that end partway through a sponge word
+#ifdef LYRA2_DISPATCH
+    __builtin_cpu_init();
+    for (unsigned int k = 0; k < sizeof(keylens) / sizeof(keylens[0]); k++) {
+        char expected[128];
+        memset(expected, 0x00, sizeof(expected));
+        ck_assert(hash_sse2(expected, keylens[k], "password", "salt", 8, 16, 3) == 0);
+
+        for (unsigned int i = 1; i < sizeof(isas) / sizeof(isas[0]); i++) {
+            if (!isas[i].supported()) {
+                printf("dispatch_isas_agree: skipping unsupported %s\n", isas[i].name);
+                continue;
+            }
+
+            char key[128];
+            memset(key, 0xff, sizeof(key));
+            ck_assert(isas[i].hash(key, keylens[k], "password", "salt", 8, 16, 3) == 0);
+            ck_assert(!memcmp(key, expected, keylens[k]));
+        }
+    }
+#endif
+    return;
+
+}
+END_TEST
+
+START_TEST(invalid_costs)
+{
+#line 283
+    // costs that leave no matrix to fill or visit are rejected before
+    // allocating anything for them
+    char key[64];
+    ck_assert(hash(key, sizeof(key), "password", "salt", 2, 16, 1) == -1);
+    ck_assert(hash(key, sizeof(key), "password", "salt", 8, 16, 0) == -1);
+#ifndef USE_PHS_INTERFACE
+    ck_assert(hash(key, sizeof(key), "password", "salt", 8, 0, 1) == -1);
+    ck_assert(lyra2_parallel(key, sizeof(key), "password", 8, "salt", 4,
+                             8, 0, 1, 2) == -1);
+#endif
+
+    ck_assert(lyra2_ctx_new(8, 0) == NULL);
+    ck_assert(lyra2_ctx_new(0, 16) == NULL);
+    return;
+
+}
+END_TEST
+
+START_TEST(with_ctx)
+{
+#line 299
+    // a context reused across costs up to the ones it was created for must
+    // derive the same keys as allocating a matrix for each
+    struct lyra2_ctx *ctx = lyra2_ctx_new(MAX_R, MAX_C);
+    ck_assert(ctx != NULL);
+    for (unsigned int r = 0; r < NELEMS(Rs); r++) {
+        for (unsigned int c = 0; c < NELEMS(Cs); c++) {
+            for (unsigned int t = 0; t < NELEMS(Ts); t++) {
+                const char *pwd = pwds[(r + t) % NINPUTS], *salt = salts[c % NINPUTS];
+                char expected[48], key[48];
+                ck_assert(hash(expected, sizeof(expected), pwd, salt, Rs[r], Cs[c], Ts[t]) == 0);
+                ck_assert(hash_with_ctx(ctx, key, sizeof(key), pwd, salt, Rs[r], Cs[c], Ts[t]) == 0);
+                ck_assert(!memcmp(key, expected, sizeof(key)));
+            }
+        }
+    }
+
+    char key[48];
+    ck_assert(hash_with_ctx(ctx, key, sizeof(key), "password", "salt", MAX_R + 1, MAX_C, 1) == -1);
+    lyra2_ctx_free(ctx);
+    return;
+
+}
+END_TEST
+
+START_TEST(with_sponge)
+{
+#line 321
+    // BLAKE2b with the default (0) or explicit single round is plain Lyra2
+    for (unsigned int r = 0; r < NELEMS(Rs); r++) {
+        for (unsigned int c = 0; c < NELEMS(Cs); c++) {
+            for (unsigned int t = 0; t < NELEMS(Ts); t++) {
+                const char *pwd = pwds[(r + c) % NINPUTS], *salt = salts[t % NINPUTS];
+                char expected[48], key[48];
+                ck_assert(hash(expected, sizeof(expected), pwd, salt, Rs[r], Cs[c], Ts[t]) == 0);
+                for (unsigned int rho = 0; rho <= 1; rho++) {
+                    ck_assert(hash_with_sponge(key, sizeof(key), pwd, salt, Rs[r], Cs[c], Ts[t],
+                                               LYRA2_SPONGE_BLAKE2B, rho) == 0);
+                    ck_assert(!memcmp(key, expected, sizeof(key)));
+                }
+            }
+        }
+    }
+    return;
+
+}
+END_TEST
+
+START_TEST(x4)
+{
+#line 339
+    // each lane of the _x4 variants must derive the key of its own inputs
+    for (unsigned int r = 0; r < NELEMS(Rs); r++) {
+        for (unsigned int c = 0; c < NELEMS(Cs); c++) {
+            for (unsigned int t = 0; t < NELEMS(Ts); t++) {
+                char keys[LYRA2_X4_LANES][48], *key[LYRA2_X4_LANES];
+                const char *pwd[LYRA2_X4_LANES], *salt[LYRA2_X4_LANES];
+                for (unsigned int lane = 0; lane < LYRA2_X4_LANES; lane++) {
+                    key[lane] = keys[lane];
+                    pwd[lane] = pwds[(lane + r) % NINPUTS];
+                    salt[lane] = salts[(lane + t) % NINPUTS];
+                }
+
+                ck_assert(hash_x4(key, sizeof(keys[0]), pwd, salt, Rs[r], Cs[c], Ts[t]) == 0);
+                for (unsigned int lane = 0; lane < LYRA2_X4_LANES; lane++) {
+                    char expected[48];
+                    ck_assert(hash(expected, sizeof(expected), pwd[lane], salt[lane],
+                                   Rs[r], Cs[c], Ts[t]) == 0);
+                    ck_assert(!memcmp(keys[lane], expected, sizeof(expected)));
+                }
+            }
+        }
+    }
+    return;
+
+}
+END_TEST
+
+START_TEST(interleaved)
+{
+#line 364
+    // jobs with mixed costs, hashed on any number of lanes with or without
+    // contexts, must derive the same keys as hashing them one at a time
+    static char expected[NCOSTS][48], keys[NCOSTS][48];
+    job_t jobs[NCOSTS];
+    unsigned int njobs = 0;
+    for (unsigned int r = 0; r < NELEMS(Rs); r++) {
+        for (unsigned int c = 0; c < NELEMS(Cs); c++) {
+            for (unsigned int t = 0; t < NELEMS(Ts); t++) {
+                const char *pwd = pwds[njobs % NINPUTS], *salt = salts[(njobs / NINPUTS) % NINPUTS];
+                ck_assert(hash(expected[njobs], sizeof(expected[0]), pwd, salt, Rs[r], Cs[c], Ts[t]) == 0);
+                jobs[njobs] = make_job(keys[njobs], sizeof(keys[0]), pwd, salt, Rs[r], Cs[c], Ts[t]);
+                njobs++;
+            }
+        }
+    }
+
+    struct lyra2_ctx *ctx[5];
+    for (unsigned int l = 0; l < 5; l++) {
+        ctx[l] = lyra2_ctx_new(MAX_R, MAX_C);
+        ck_assert(ctx[l] != NULL);
+    }
+
+    for (unsigned int nlanes = 1; nlanes <= 5; nlanes++) {
+        memset(keys, 0, sizeof(keys));
+        ck_assert(hash_interleaved(jobs, njobs, nlanes) == 0);
+        ck_assert(!memcmp(keys, expected, sizeof(keys)));
+
+        memset(keys, 0, sizeof(keys));
+        ck_assert(hash_interleaved_with_ctx(ctx, nlanes, jobs, njobs) == 0);
+        ck_assert(!memcmp(keys, expected, sizeof(keys)));
+    }
+
+    for (unsigned int l = 0; l < 5; l++) {
+        lyra2_ctx_free(ctx[l]);
+    }
+    return;
+
+}
+END_TEST
+
+START_TEST(parallel_one_thread)
+{
+#line 402
+    // with a single thread, parallel Lyra2 is the regular one
+    for (unsigned int r = 0; r < NELEMS(Rs); r++) {
+        for (unsigned int t = 0; t < NELEMS(Ts); t++) {
+            const char *pwd = pwds[r % NINPUTS], *salt = salts[t % NINPUTS];
+            char expected[48], key[48];
+            ck_assert(hash(expected, sizeof(expected), pwd, salt, Rs[r], MAX_C, Ts[t]) == 0);
+            ck_assert(hash_parallel(key, sizeof(key), pwd, salt, Rs[r], MAX_C, Ts[t], 1) == 0);
+            ck_assert(!memcmp(key, expected, sizeof(key)));
+        }
+    }
+    return;
+
+}
+END_TEST
+
+START_TEST(known_answers)
+{
+#line 415
+    // fixed keys, which any build with the same parameters must derive,
+    // whatever its row layout (ROW_PAD, REVERSED_ROWS) or kernels. The
+    // 128-bit ones are the reference implementation's.
+#ifdef HAVE_KNOWN_ANSWERS
+    static const struct {
+        uint32_t R, T;
+        uint8_t key[64];
+    } answers[] = {
+#if RT_BITS == 128
+        { 3, 1, {
+            0xf9, 0xcd, 0x06, 0x32, 0xa6, 0x08, 0x40, 0x43,
+            0xda, 0x51, 0x28, 0x3b, 0xa6, 0x28, 0x66, 0x11,
+            0x7e, 0xb1, 0xec, 0x5b, 0xe3, 0x31, 0xe5, 0xdd,
+            0xfa, 0xd8, 0x57, 0x80, 0x35, 0x6e, 0xa6, 0x2e,
+            0x33, 0xbc, 0xaf, 0xa0, 0xb8, 0xcb, 0x13, 0x97,
+            0xd3, 0x82, 0xd2, 0x63, 0xdc, 0x69, 0xf2, 0x7a,
+            0x58, 0xc7, 0x25, 0x8c, 0xf6, 0xe6, 0xe5, 0x6f,
+            0x28, 0x73, 0x81, 0xeb, 0x40, 0x78, 0x21, 0xa8
+        } },
+        { 17, 5, {
+            0xd9, 0xe9, 0xaa, 0xc3, 0xc4, 0x3a, 0x27, 0x08,
+            0x13, 0x47, 0x83, 0x99, 0x13, 0x46, 0xad, 0x44,
+            0xae, 0x21, 0x48, 0x03, 0xd9, 0x4a, 0x3e, 0x72,
+            0x40, 0x38, 0x0f, 0xee, 0xd3, 0xbd, 0x3f, 0x63,
+            0x6a, 0x82, 0xef, 0x69, 0xcd, 0x78, 0xc8, 0xc3,
+            0x1f, 0xd7, 0x93, 0xfe, 0x34, 0x1c, 0x2d, 0x13,
+            0xa0, 0x0d, 0xb9, 0x85, 0x9c, 0x6e, 0xc3, 0x8a,
+            0xb4, 0x44, 0x62, 0x81, 0x93, 0x67, 0x4b, 0x43
+        } },
+#else
+        { 3, 1, {
+            0x54, 0x98, 0x80, 0x48, 0xbf, 0xaf, 0x9f, 0x4d,
+            0x5e, 0xa9, 0x72, 0x27, 0x6c, 0x3d, 0xc7, 0xab,
+            0x37, 0xb1, 0x17, 0x20, 0xbe, 0x03, 0x61, 0x0e,
+            0xc7, 0x7a, 0xe6, 0xef, 0xec, 0xb8, 0xb3, 0x03,
+            0xbc, 0xa7, 0xe7, 0x5c, 0x2f, 0x17, 0x28, 0x62,
+            0x72, 0xef, 0x38, 0x87, 0x0d, 0xbb, 0xd1, 0xb5,
+            0x9e, 0x62, 0x6e, 0xe1, 0x8b, 0x8e, 0xec, 0x23,
+            0xd4, 0xd8, 0x88, 0x71, 0x38, 0x03, 0x3e, 0x31
+        } },
+        { 17, 5, {
+            0xa9, 0xa7, 0xb3, 0x00, 0x7b, 0xfd, 0x46, 0x72,
+            0xe7, 0xa6, 0xf3, 0x8d, 0x54, 0xd8, 0xfe, 0xb1,
+            0xe4, 0xdf, 0x27, 0x28, 0x60, 0xcf, 0x4b, 0xaa,
+            0x53, 0x8c, 0xec, 0xe9, 0x6c, 0xf5, 0xea, 0xcd,
+            0x24, 0x2d, 0xf6, 0xde, 0xf4, 0x9f, 0x32, 0xf1,
+            0xa2, 0x4e, 0xba, 0x15, 0x88, 0xde, 0x98, 0xb5,
+            0x14, 0x07, 0xcb, 0xa6, 0x52, 0xbc, 0x94, 0xfc,
+            0x3e, 0x4d, 0x2e, 0x7e, 0xc5, 0x8a, 0x1f, 0x81
+        } },
+#endif
+    };
+
+    for (unsigned int i = 0; i < NELEMS(answers); i++) {
+        char key[64];
+        ck_assert(hash(key, sizeof(key), "Lyra sponge", "saltsaltsaltsalt",
+                       answers[i].R, 256, answers[i].T) == 0);
+        ck_assert(!memcmp(key, answers[i].key, sizeof(key)));
+    }
+#endif
+    return;
+
+}
+END_TEST
+
+START_TEST(parallel_known_answers)
+{
+#line 478
+    // as known_answers, for parallel Lyra2. The 128-bit keys are those of the
+    // reference implementation built with nPARALLEL=2 and 4, patched as
+    // described in README.md.
+#ifdef HAVE_KNOWN_ANSWERS
+    static const struct {
+        uint32_t R, T;
+        unsigned int nthreads;
+        uint8_t key[64];
+    } answers[] = {
+#if RT_BITS == 128
+        { 24, 2, 2, {
+            0x2c, 0xb2, 0x07, 0x48, 0x56, 0x9d, 0x84, 0xff,
+            0x48, 0x96, 0x04, 0xc5, 0xa4, 0x66, 0x90, 0x05,
+            0xbd, 0x62, 0x09, 0x02, 0xbc, 0x3f, 0xde, 0xe4,
+            0x76, 0x6c, 0x37, 0xa4, 0xa9, 0xa9, 0x17, 0x9d,
+            0xe5, 0x45, 0x98, 0x5c, 0xd7, 0x63, 0x74, 0xc1,
+            0xc9, 0x5b, 0x26, 0x55, 0x91, 0xba, 0xc2, 0x88,
+            0x21, 0x7f, 0x98, 0x09, 0x37, 0x37, 0x08, 0xcf,
+            0xc9, 0x67, 0x42, 0x66, 0x4e, 0x5b, 0x5c, 0x87
+        } },
+        { 24, 2, 4, {
+            0xcd, 0x17, 0x4d, 0x38, 0x84, 0x95, 0x36, 0xeb,
+            0xb9, 0x7b, 0x1b, 0x46, 0x3b, 0xe4, 0x17, 0x1d,
+            0x82, 0x14, 0x4c, 0x71, 0x48, 0xf0, 0xe8, 0x33,
+            0x0f, 0x39, 0x64, 0xb0, 0x7c, 0x81, 0x52, 0x18,
+            0x90, 0xd4, 0xfa, 0x69, 0x87, 0xdb, 0xec, 0xf7,
+            0x00, 0xb2, 0xc2, 0x20, 0x4c, 0xd4, 0x66, 0x18,
+            0x6e, 0xb5, 0xdb, 0x9c, 0x72, 0xb8, 0x11, 0xa3,
+            0x29, 0xe1, 0x7f, 0x2e, 0xe7, 0x83, 0x3f, 0x08
+        } },
+        { 48, 1, 4, {
+            0x7c, 0xd1, 0x15, 0x42, 0x21, 0xa8, 0x6f, 0x03,
+            0x3f, 0xb1, 0x84, 0xc7, 0xc4, 0x36, 0xe9, 0x52,
+            0x3b, 0xfd, 0x96, 0x95, 0x60, 0xce, 0xa2, 0x34,
+            0x17, 0x21, 0x0b, 0x1e, 0xc2, 0x9d, 0x45, 0x20,
+            0xb5, 0x4f, 0x10, 0x77, 0xc9, 0x9a, 0xed, 0x74,
+            0xe9, 0xa4, 0x10, 0xae, 0x7e, 0x33, 0x4d, 0x1a,
+            0x0f, 0x31, 0x42, 0xf0, 0x1a, 0x55, 0xa5, 0x33,
+            0x9f, 0xe3, 0x9b, 0xf3, 0x92, 0x3b, 0x9c, 0x3c
+        } },
+#else
+        { 24, 2, 2, {
+            0xa8, 0x14, 0x57, 0xe3, 0x95, 0x09, 0x02, 0x1f,
+            0xeb, 0x4d, 0xd9, 0x74, 0x67, 0xb4, 0x79, 0x08,
+            0xc0, 0x9f, 0x0c, 0x81, 0xaf, 0xdc, 0xa8, 0xea,
+            0x75, 0x04, 0x9b, 0xdd, 0xf1, 0xc3, 0x2b, 0xa9,
+            0x35, 0x1f, 0xf7, 0x9c, 0x6e, 0xc7, 0x9a, 0x6d,
+            0x11, 0xc7, 0x11, 0x5d, 0xd8, 0xb1, 0x9e, 0xa8,
+            0x7d, 0xbf, 0xa3, 0xde, 0xcc, 0xee, 0x77, 0xed,
+            0x9c, 0x4a, 0xdb, 0x7e, 0x0d, 0x0d, 0x0a, 0x3b
+        } },
+        { 24, 2, 4, {
+            0x88, 0xd0, 0xca, 0x25, 0xe7, 0x70, 0xfa, 0xdc,
+            0x52, 0x55, 0xbd, 0x58, 0xb2, 0x4b, 0x46, 0xf7,
+            0x77, 0x96, 0x7b, 0x85, 0xae, 0xa2, 0x9f, 0x5f,
+            0xf6, 0x44, 0x9f, 0x49, 0x93, 0x41, 0x93, 0x73,
+            0x6a, 0xef, 0x2a, 0x2b, 0x38, 0x5e, 0x6c, 0x03,
+            0x97, 0x5b, 0xb1, 0xd4, 0xd5, 0x8d, 0xe5, 0xd9,
+            0xf0, 0x4c, 0xae, 0xf3, 0xef, 0x72, 0xb7, 0x81,
+            0x4a, 0x8e, 0xec, 0x9b, 0x18, 0xfd, 0xf3, 0x74
+        } },
+        { 48, 1, 4, {
+            0x7d, 0x52, 0xd8, 0x48, 0xcf, 0xb9, 0x8a, 0x7f,
+            0x88, 0x34, 0xbc, 0x19, 0x7a, 0xb0, 0x72, 0xbd,
+            0x1f, 0x3b, 0x46, 0x67, 0xa9, 0x52, 0xac, 0x43,
+            0x95, 0x51, 0x51, 0x4c, 0x56, 0x55, 0x8c, 0xc0,
+            0x69, 0xa6, 0xdc, 0xf9, 0x3d, 0xac, 0x24, 0xe2,
+            0x78, 0x71, 0xb7, 0xe1, 0xc1, 0x07, 0x46, 0x0f,
+            0x58, 0xa7, 0x4d, 0x47, 0xad, 0x12, 0x4d, 0x1c,
+            0x18, 0x6b, 0x99, 0x1c, 0x94, 0x85, 0xac, 0x67
+        } },
+#endif
+    };
+
+    for (unsigned int i = 0; i < NELEMS(answers); i++) {
+        char key[64];
+        ck_assert(hash_parallel(key, sizeof(key), "Lyra sponge", "saltsaltsaltsalt",
+                                answers[i].R, 256, answers[i].T,
+                                answers[i].nthreads) == 0);
+        ck_assert(!memcmp(key, answers[i].key, sizeof(key)));
+    }
+#endif
+    return;
+}
+END_TEST
+
+#define tcase_add_test(tc, test) test()
+
+int main(void)
+{
+    tcase_add_test(tc1_1, key_tail);
+    tcase_add_test(tc1_1, dispatch_isas_agree);
+    tcase_add_test(tc1_1, invalid_costs);
+    tcase_add_test(tc1_1, with_ctx);
+    tcase_add_test(tc1_1, with_sponge);
+    tcase_add_test(tc1_1, x4);
+    tcase_add_test(tc1_1, interleaved);
+    tcase_add_test(tc1_1, parallel_one_thread);
+    tcase_add_test(tc1_1, known_answers);
+    tcase_add_test(tc1_1, parallel_known_answers);
+    return 0;
+}
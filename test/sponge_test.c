@@ -10,9 +10,14 @@
 #include <assert.h>
 #define ck_assert assert
 
+GEN_SPONGE_ROW_DUPLEXING(duplex_row,
+    sponge_reduced_extended_duplexing(&row_sponge, in[col], out[col], 0);,
+    sponge_word_t (*in)[SPONGE_EXTENDED_RATE_LENGTH],
+    sponge_word_t (*out)[SPONGE_EXTENDED_RATE_LENGTH])
+
 START_TEST(sponge_compress_IV)
 {
-#line 9
+#line 14
     const uint8_t expected[SPONGE_STATE_SIZE_BYTES] = {
         0x2d, 0x56, 0x47, 0x55, 0x66, 0x10, 0x9f, 0xe6,
         0x27, 0xaf, 0x2a, 0x6d, 0x2e, 0xe8, 0x66, 0xfe,
@@ -33,7 +38,7 @@ START_TEST(sponge_compress_IV)
     };
 
     sponge_t *sponge = sponge_new();
-    sponge_compress(sponge, false);
+    sponge_compress(sponge, 0);
     ck_assert(!memcmp(sponge->state, expected, SPONGE_STATE_SIZE_BYTES));
     return;
 
@@ -42,7 +47,7 @@ END_TEST
 
 START_TEST(sponge_compress_IV_reduced)
 {
-#line 34
+#line 39
     const uint8_t expected[SPONGE_STATE_SIZE_BYTES] = {
         0xe3, 0x5c, 0x9a, 0x28, 0x68, 0x25, 0x1c, 0xd1,
         0x75, 0x4d, 0xe8, 0xd4, 0xb5, 0x96, 0xf8, 0xad,
@@ -63,18 +68,165 @@ START_TEST(sponge_compress_IV_reduced)
     };
 
     sponge_t *sponge = sponge_new();
-    sponge_compress(sponge, true);
+    sponge_compress(sponge, SPONGE_FLAG_REDUCED);
+    ck_assert(!memcmp(sponge->state, expected, SPONGE_STATE_SIZE_BYTES));
+    return;
+
+}
+END_TEST
+
+START_TEST(sponge_compress_IV_blamka)
+{
+#line 64
+    // the state after applying BlaMka instead of BLAKE2b, as computed by the
+    // reference implementation built with Sponge=1.
+    const uint8_t expected[SPONGE_STATE_SIZE_BYTES] = {
+        0x5b, 0x27, 0xc2, 0xdf, 0x3e, 0x2b, 0x0a, 0xd7,
+        0x47, 0x47, 0x50, 0x1d, 0xe1, 0xb8, 0x06, 0x51,
+        0x91, 0xa0, 0x1a, 0x93, 0x72, 0x43, 0xe9, 0x65,
+        0x08, 0x0a, 0x11, 0xc9, 0x7e, 0x64, 0x8a, 0x86,
+        0xbf, 0x6b, 0x6f, 0x6e, 0x25, 0xf8, 0xf1, 0x7b,
+        0xd4, 0xa2, 0x6f, 0x94, 0x08, 0x5f, 0xf5, 0x55,
+        0x6c, 0x0c, 0x21, 0x33, 0x0d, 0xed, 0x14, 0xe7,
+        0xd5, 0xea, 0x6e, 0x2b, 0xc6, 0x2d, 0x9c, 0x1d,
+        0xae, 0xe1, 0xa4, 0xe9, 0xa9, 0xbf, 0xdc, 0x58,
+        0x02, 0x67, 0x5e, 0xfb, 0x60, 0x51, 0xeb, 0xdd,
+        0xf1, 0x90, 0x77, 0xd6, 0xad, 0x27, 0xa2, 0x6b,
+        0x40, 0xd7, 0x86, 0xef, 0x84, 0x32, 0xcc, 0x20,
+        0x50, 0xb8, 0x66, 0x52, 0x74, 0x3d, 0xd2, 0x17,
+        0x64, 0x96, 0xf3, 0x56, 0x81, 0xd4, 0x03, 0x7b,
+        0x17, 0x9b, 0x39, 0xba, 0x29, 0x3c, 0x83, 0x20,
+        0x81, 0x14, 0xb4, 0x6a, 0xa9, 0x85, 0x63, 0xbe
+    };
+
+    sponge_t *sponge = sponge_new();
+    sponge_compress(sponge, SPONGE_FLAG_BLAMKA);
     ck_assert(!memcmp(sponge->state, expected, SPONGE_STATE_SIZE_BYTES));
     return;
 
 }
 END_TEST
 
+START_TEST(sponge_compress_IV_reduced_blamka)
+{
+#line 91
+    const uint8_t expected[SPONGE_STATE_SIZE_BYTES] = {
+        0x17, 0x2d, 0x26, 0x49, 0xb2, 0x77, 0xb1, 0xc3,
+        0xff, 0x86, 0x1d, 0x79, 0x87, 0x4f, 0xe8, 0xa4,
+        0x2b, 0x5b, 0x02, 0x5f, 0x76, 0x48, 0x41, 0xd7,
+        0x94, 0x4a, 0xe7, 0x13, 0xfd, 0x1c, 0xb9, 0x70,
+        0x90, 0xa7, 0x72, 0x9a, 0x85, 0xa7, 0xda, 0x33,
+        0xe5, 0x2e, 0xb4, 0xab, 0xb5, 0xfc, 0x24, 0x37,
+        0x7f, 0x54, 0xf3, 0x0d, 0xe5, 0xef, 0x82, 0x76,
+        0xb1, 0x47, 0x71, 0xf5, 0x70, 0xf7, 0xe3, 0x39,
+        0x59, 0x4c, 0xd8, 0x8a, 0x2c, 0x36, 0xd3, 0x4c,
+        0xab, 0xe0, 0x1e, 0x95, 0x0f, 0x6b, 0xf8, 0xcb,
+        0xcf, 0x8e, 0x9e, 0x33, 0x0a, 0x8c, 0x40, 0x5f,
+        0x37, 0xd5, 0x24, 0xb4, 0x45, 0x1c, 0x05, 0xbd,
+        0x07, 0x48, 0x84, 0x3d, 0xc7, 0x63, 0x8d, 0x87,
+        0x28, 0x18, 0x63, 0xf5, 0x57, 0x6e, 0x68, 0x7f,
+        0x18, 0xe2, 0x98, 0x23, 0xd6, 0x8f, 0x73, 0xee,
+        0x81, 0x40, 0x1d, 0xf5, 0x00, 0x2c, 0x80, 0x82
+    };
+
+    sponge_t *sponge = sponge_new();
+    sponge_compress(sponge, SPONGE_FLAG_REDUCED | SPONGE_FLAG_BLAMKA);
+    ck_assert(!memcmp(sponge->state, expected, SPONGE_STATE_SIZE_BYTES));
+    return;
+
+}
+END_TEST
+
+START_TEST(sponge_compress_rho)
+{
+#line 116
+    // rho rounds are the same as rho single-round compressions, and the full
+    // compression function is the same as SPONGE_FULL_ROUNDS of them (each
+    // BlaMka round of the full function counting twice, as in the reference
+    // implementation).
+    const int sponges[] = { 0, SPONGE_FLAG_BLAMKA };
+    for (unsigned int s = 0; s < sizeof(sponges) / sizeof(sponges[0]); s++) {
+        for (int rho = 1; rho <= SPONGE_MAX_RHO; rho++) {
+            sponge_t *expected = sponge_new();
+            for (int i = 0; i < rho; i++) {
+                sponge_compress(expected, SPONGE_FLAG_REDUCED |
+                                SPONGE_FLAG_RHO(1) | sponges[s]);
+            }
+
+            sponge_t *sponge = sponge_new();
+            sponge_compress(sponge, SPONGE_FLAG_REDUCED |
+                            SPONGE_FLAG_RHO(rho) | sponges[s]);
+            ck_assert(!memcmp(sponge->state, expected->state,
+                              SPONGE_STATE_SIZE_BYTES));
+            sponge_destroy(sponge);
+            sponge_destroy(expected);
+        }
+
+        const int nrounds = sponges[s] == SPONGE_FLAG_BLAMKA ?
+            2 * SPONGE_FULL_ROUNDS : SPONGE_FULL_ROUNDS;
+        sponge_t *expected = sponge_new();
+        for (int i = 0; i < nrounds; i++) {
+            sponge_compress(expected, SPONGE_FLAG_REDUCED |
+                            SPONGE_FLAG_RHO(1) | sponges[s]);
+        }
+
+        sponge_t *sponge = sponge_new();
+        sponge_compress(sponge, sponges[s]);
+        ck_assert(!memcmp(sponge->state, expected->state,
+                          SPONGE_STATE_SIZE_BYTES));
+        sponge_destroy(sponge);
+        sponge_destroy(expected);
+    }
+    return;
+
+}
+END_TEST
+
 START_TEST(squeeze_IV)
 {
-#line 59
+#line 156
     // the output of the squeeze function on a just-initialized
-    // sponge in Lyra2's reference SSE implementation.
+    // sponge in Lyra2's reference SSE implementation, built with
+    // bSponge=SPONGE_BLOCK_WORDS.
+#if SPONGE_BLOCK_WORDS == 8
+    const uint8_t expected[] = {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x2d, 0x56, 0x47, 0x55, 0x66, 0x10, 0x9f, 0xe6,
+        0x27, 0xaf, 0x2a, 0x6d, 0x2e, 0xe8, 0x66, 0xfe,
+        0x68, 0x1c, 0x33, 0xac, 0x12, 0xbf, 0xa7, 0xe5,
+        0x5a, 0x17, 0x6a, 0x4a, 0x05, 0xcf, 0xc2, 0x0c,
+        0x5f, 0xcb, 0x98, 0x08, 0x3e, 0xed, 0x74, 0xa2,
+        0x8a, 0x2d, 0xbb, 0xa3, 0x06, 0x7b, 0x21, 0x8a,
+        0x7b, 0x38, 0x21, 0x5b, 0xc7, 0xc8, 0x52, 0x1d,
+        0xfe, 0x2b, 0x01, 0x56, 0xf1, 0xe0, 0x38, 0x09
+    };
+#elif SPONGE_BLOCK_WORDS == 10
+    const uint8_t expected[] = {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x08, 0xc9, 0xbc, 0xf3, 0x67, 0xe6, 0x09, 0x6a,
+        0x3b, 0xa7, 0xca, 0x84, 0x85, 0xae, 0x67, 0xbb,
+        0x2d, 0x56, 0x47, 0x55, 0x66, 0x10, 0x9f, 0xe6,
+        0x27, 0xaf, 0x2a, 0x6d, 0x2e, 0xe8, 0x66, 0xfe,
+        0x68, 0x1c, 0x33, 0xac, 0x12, 0xbf, 0xa7, 0xe5,
+        0x5a, 0x17, 0x6a, 0x4a, 0x05, 0xcf, 0xc2, 0x0c,
+        0x5f, 0xcb, 0x98, 0x08, 0x3e, 0xed, 0x74, 0xa2,
+        0x8a, 0x2d, 0xbb, 0xa3, 0x06, 0x7b, 0x21, 0x8a
+    };
+#else
     const uint8_t expected[] = {
         0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
         0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
@@ -93,6 +245,7 @@ START_TEST(squeeze_IV)
         0x68, 0x1c, 0x33, 0xac, 0x12, 0xbf, 0xa7, 0xe5,
         0x5a, 0x17, 0x6a, 0x4a, 0x05, 0xcf, 0xc2, 0x0c
     };
+#endif
 
     ALIGN(SPONGE_MEM_ALIGNMENT)
     uint8_t squeezed[sizeof(expected) / sizeof(uint8_t)] = {0};
@@ -109,7 +262,7 @@ END_TEST
 
 START_TEST(absorb_block_safe)
 {
-#line 91
+#line 229
     // safe full-round block absortion, done at the beginning of the
     // setup phase
     ALIGN(SPONGE_MEM_ALIGNMENT)
@@ -155,9 +308,11 @@ END_TEST
 
 START_TEST(absorb_block_extended)
 {
-#line 132
+#line 270
     // full-round absortion with extended rate, done at the end
-    // of the wandering phase
+    // of the wandering phase. Only the first SPONGE_EXTENDED_RATE_SIZE_BYTES
+    // of data are absorbed; the expected states come from the reference
+    // implementation built with bSponge=SPONGE_BLOCK_WORDS.
     const uint8_t state[SPONGE_STATE_SIZE_BYTES] = {
         0x67, 0xaf, 0x5b, 0x55, 0x80, 0xd4, 0xce, 0xc7,
         0xd9, 0x16, 0x76, 0x4b, 0xe6, 0x65, 0xbf, 0x6f,
@@ -193,6 +348,45 @@ START_TEST(absorb_block_extended)
         0xed, 0x0c, 0xdf, 0x98, 0x4a, 0xdc, 0x93, 0xdd
     };
 
+#if SPONGE_BLOCK_WORDS == 8
+    uint8_t expected[] = {
+        0xbd, 0xc5, 0x15, 0x31, 0x4e, 0x1b, 0xc9, 0xc2,
+        0x7c, 0x27, 0xb3, 0x2f, 0x31, 0xb2, 0x26, 0xc2,
+        0x9b, 0x8c, 0x19, 0xd9, 0xec, 0x33, 0x8b, 0x26,
+        0x6e, 0xdc, 0x46, 0xc1, 0x26, 0xd4, 0x58, 0xe6,
+        0x9a, 0x08, 0xcb, 0x7d, 0x88, 0xdf, 0x16, 0x32,
+        0xb6, 0xd4, 0xce, 0x10, 0x6f, 0x47, 0x57, 0xf9,
+        0x4d, 0x5c, 0xf8, 0x77, 0x1c, 0x43, 0xf3, 0x9c,
+        0xca, 0x13, 0xa4, 0xd0, 0xfa, 0x82, 0x4f, 0xb5,
+        0x95, 0x96, 0x8d, 0x60, 0xc3, 0x78, 0xed, 0xd0,
+        0xaf, 0x50, 0x17, 0x3f, 0x48, 0x78, 0x72, 0x23,
+        0x80, 0xed, 0x4f, 0x2a, 0xa4, 0x82, 0xe4, 0x2f,
+        0x7c, 0x78, 0x60, 0x1c, 0xce, 0x17, 0x45, 0x17,
+        0xaa, 0x54, 0xc3, 0xf8, 0x71, 0x2b, 0x03, 0x6c,
+        0x59, 0x3e, 0x28, 0xab, 0xaf, 0x50, 0x89, 0xb5,
+        0x21, 0x03, 0x42, 0x69, 0x14, 0x9b, 0xad, 0xf6,
+        0x03, 0x58, 0xf3, 0x86, 0x7e, 0xca, 0xc4, 0xe9
+    };
+#elif SPONGE_BLOCK_WORDS == 10
+    uint8_t expected[] = {
+        0x9b, 0x12, 0x2e, 0x27, 0xdc, 0x6e, 0xf1, 0xda,
+        0xe5, 0x94, 0xaa, 0x4e, 0x14, 0xd6, 0x4d, 0xfe,
+        0x48, 0x4c, 0xb9, 0x59, 0xfb, 0xfd, 0xa9, 0xb4,
+        0x1d, 0x61, 0x46, 0x45, 0x20, 0x4a, 0x04, 0x21,
+        0x02, 0x2b, 0x9e, 0xd0, 0x20, 0x3f, 0x81, 0x3a,
+        0x5f, 0x2c, 0xfc, 0x28, 0x6e, 0x6c, 0x9d, 0x1e,
+        0x02, 0xa0, 0x41, 0x79, 0xd3, 0xee, 0x22, 0x1b,
+        0x10, 0x08, 0xcf, 0x46, 0xc8, 0xe2, 0x1b, 0x0b,
+        0x82, 0x58, 0x2f, 0x3a, 0x06, 0x38, 0x42, 0x82,
+        0x81, 0x52, 0x93, 0xcf, 0xcc, 0x2f, 0xf5, 0x0a,
+        0x62, 0x70, 0x88, 0xc2, 0x4f, 0xb1, 0xa3, 0x74,
+        0x7f, 0x06, 0xab, 0x17, 0x43, 0x1f, 0x67, 0x08,
+        0x68, 0x48, 0x3f, 0xfe, 0x33, 0x9d, 0xce, 0x66,
+        0x73, 0x4a, 0x69, 0x33, 0xd8, 0xae, 0x93, 0xaf,
+        0xa1, 0xdc, 0x7c, 0x21, 0x0d, 0xca, 0x38, 0xdd,
+        0xd1, 0xc1, 0xa6, 0x90, 0x66, 0x15, 0x3f, 0x8f
+    };
+#else
     uint8_t expected[] = {
         0xe5, 0xf2, 0xe3, 0x37, 0xaa, 0x89, 0xf9, 0xdb,
         0x46, 0xb3, 0x51, 0xd9, 0xac, 0x93, 0xd4, 0x16,
@@ -211,11 +405,12 @@ START_TEST(absorb_block_extended)
         0x8f, 0x1d, 0x34, 0x5f, 0x1b, 0x9c, 0x2d, 0x5d,
         0x9f, 0x1f, 0x3e, 0xdb, 0x3f, 0xee, 0x77, 0x97
     };
+#endif
 
     sponge_t *sponge = sponge_new();
     memcpy(sponge->state, state, SPONGE_STATE_SIZE_BYTES);
     int flags = SPONGE_FLAG_EXTENDED_RATE | SPONGE_FLAG_ASSUME_PADDING;
-    sponge_absorb(sponge, (sponge_word_t *) data, sizeof(data), flags);
+    sponge_absorb(sponge, (sponge_word_t *) data, SPONGE_EXTENDED_RATE_SIZE_BYTES, flags);
 
     ck_assert(!memcmp(sponge->state, expected, SPONGE_STATE_SIZE_BYTES));
     sponge_destroy(sponge);
@@ -224,11 +419,134 @@ START_TEST(absorb_block_extended)
 }
 END_TEST
 
+START_TEST(absorb_streaming)
+{
+#line 378
+    // absorbing unaligned pieces of a message, with and without the extended
+    // rate, must be the same as absorbing it padded in one go
+    const int flags[] = { 0, SPONGE_FLAG_EXTENDED_RATE };
+    const size_t pieces[] = { 1, 5, 64, 0, 97, 13, 200 };
+    uint8_t message[1 + 5 + 64 + 97 + 13 + 200 + 1];
+    for (unsigned int i = 0; i < sizeof(message); i++) {
+        message[i] = i * 31 + 1;
+    }
+
+    for (unsigned int f = 0; f < sizeof(flags) / sizeof(flags[0]); f++) {
+        size_t rate = flags[f] ? SPONGE_EXTENDED_RATE_SIZE_BYTES : SPONGE_RATE_SIZE_BYTES;
+        for (size_t len = 0; len <= sizeof(message) - 1; len += 97) {
+            ALIGN(SPONGE_MEM_ALIGNMENT) uint8_t padded[sizeof(message) + 2 * SPONGE_EXTENDED_RATE_SIZE_BYTES];
+            size_t paddedlen = (len / rate + 1) * rate;
+            memset(padded, 0, sizeof(padded));
+            memcpy(padded, message + 1, len);
+            padded[len] = 0x80;
+            padded[paddedlen - 1] |= 0x01;
+
+            sponge_t *expected = sponge_new();
+            sponge_absorb(expected, (sponge_word_t *) padded, paddedlen,
+                          flags[f] | SPONGE_FLAG_ASSUME_PADDING);
+
+            sponge_t *sponge = sponge_new();
+            sponge_absorber_t absorber;
+            sponge_absorb_init(&absorber, sponge, flags[f]);
+            size_t offset = 0;
+            for (unsigned int p = 0; offset < len; p++) {
+                size_t piece = pieces[p % (sizeof(pieces) / sizeof(pieces[0]))];
+                if (piece > len - offset) {
+                    piece = len - offset;
+                }
+                sponge_absorb_update(&absorber, message + 1 + offset, piece);
+                offset += piece;
+            }
+            sponge_absorb_final(&absorber);
+
+            ck_assert(!memcmp(sponge->state, expected->state, SPONGE_STATE_SIZE_BYTES));
+            sponge_destroy(sponge);
+            sponge_destroy(expected);
+        }
+    }
+    return;
+
+}
+END_TEST
+
+START_TEST(snapshot_and_clone)
+{
+#line 423
+    // forking a sponge after a common prefix must be the same as absorbing
+    // the whole message from scratch
+    ALIGN(SPONGE_MEM_ALIGNMENT) uint8_t message[2 * SPONGE_RATE_SIZE_BYTES];
+    for (unsigned int i = 0; i < sizeof(message); i++) {
+        message[i] = i * 13 + 5;
+    }
+
+    sponge_t *expected = sponge_new();
+    sponge_absorb(expected, (sponge_word_t *) message, sizeof(message),
+                  SPONGE_FLAG_ASSUME_PADDING);
+
+    sponge_t *prefix = sponge_new();
+    sponge_absorb(prefix, (sponge_word_t *) message, SPONGE_RATE_SIZE_BYTES,
+                  SPONGE_FLAG_ASSUME_PADDING);
+
+    sponge_snapshot_t snapshot;
+    sponge_snapshot(prefix, &snapshot);
+    sponge_t *clone = sponge_clone(prefix);
+
+    sponge_absorb(prefix, (sponge_word_t *) (message + SPONGE_RATE_SIZE_BYTES),
+                  SPONGE_RATE_SIZE_BYTES, SPONGE_FLAG_ASSUME_PADDING);
+    ck_assert(!memcmp(prefix->state, expected->state, SPONGE_STATE_SIZE_BYTES));
+
+    sponge_absorb(clone, (sponge_word_t *) (message + SPONGE_RATE_SIZE_BYTES),
+                  SPONGE_RATE_SIZE_BYTES, SPONGE_FLAG_ASSUME_PADDING);
+    ck_assert(!memcmp(clone->state, expected->state, SPONGE_STATE_SIZE_BYTES));
+
+    sponge_restore(prefix, &snapshot);
+    sponge_absorb(prefix, (sponge_word_t *) (message + SPONGE_RATE_SIZE_BYTES),
+                  SPONGE_RATE_SIZE_BYTES, SPONGE_FLAG_ASSUME_PADDING);
+    ck_assert(!memcmp(prefix->state, expected->state, SPONGE_STATE_SIZE_BYTES));
+
+    sponge_destroy(expected);
+    sponge_destroy(prefix);
+    sponge_destroy(clone);
+    return;
+
+}
+END_TEST
+
+START_TEST(reset)
+{
+#line 461
+    // a reset sponge must squeeze the same as a new one
+    ALIGN(SPONGE_MEM_ALIGNMENT) uint8_t message[SPONGE_RATE_SIZE_BYTES];
+    ALIGN(SPONGE_MEM_ALIGNMENT) uint8_t expected[SPONGE_RATE_SIZE_BYTES];
+    ALIGN(SPONGE_MEM_ALIGNMENT) uint8_t out[SPONGE_RATE_SIZE_BYTES];
+    for (unsigned int i = 0; i < sizeof(message); i++) {
+        message[i] = i * 7 + 3;
+    }
+
+    sponge_t *fresh = sponge_new();
+    sponge_squeeze(fresh, (sponge_word_t *) expected, sizeof(expected), 0);
+
+    sponge_t *sponge = sponge_new();
+    sponge_absorb(sponge, (sponge_word_t *) message, sizeof(message),
+                  SPONGE_FLAG_ASSUME_PADDING);
+    sponge_reset(sponge);
+    sponge_squeeze(sponge, (sponge_word_t *) out, sizeof(out), 0);
+    ck_assert(!memcmp(out, expected, sizeof(out)));
+
+    sponge_destroy(fresh);
+    sponge_destroy(sponge);
+    return;
+
+}
+END_TEST
+
 START_TEST(reduced_extended_duplexing)
 {
-#line 198
+#line 484
     // reduced-round duplexing with extended rate, the main operation
-    // performed by Lyra2 in its filling loop and wandering phase.
+    // performed by Lyra2 in its filling loop and wandering phase. As in
+    // absorb_block_extended, only the first SPONGE_EXTENDED_RATE_SIZE_BYTES
+    // of data are duplexed.
     const uint8_t state[SPONGE_STATE_SIZE_BYTES] = {
         0xd7, 0x78, 0x76, 0xa0, 0x82, 0x2f, 0x53, 0x0a,
         0x46, 0x41, 0xa4, 0xa3, 0x9e, 0xea, 0x15, 0xf2,
@@ -267,6 +585,45 @@ START_TEST(reduced_extended_duplexing)
     ALIGN(SPONGE_MEM_ALIGNMENT)
     uint8_t duplexed[SPONGE_EXTENDED_RATE_SIZE_BYTES] = {0};
 
+#if SPONGE_BLOCK_WORDS == 8
+    const uint8_t expected[SPONGE_STATE_SIZE_BYTES] = {
+        0xfc, 0x9c, 0xb7, 0xce, 0x77, 0x02, 0xc8, 0x6f,
+        0xba, 0x72, 0x2a, 0x47, 0x23, 0x6d, 0xde, 0xf2,
+        0x61, 0x7a, 0x20, 0x89, 0x1f, 0xee, 0xb5, 0x09,
+        0x05, 0x81, 0x8f, 0x02, 0x4e, 0x5d, 0x21, 0x00,
+        0x0c, 0x2e, 0xd0, 0x14, 0xfb, 0x04, 0xd5, 0x8e,
+        0xff, 0x29, 0x8e, 0x2d, 0xc7, 0x17, 0xb1, 0xd8,
+        0x6e, 0xde, 0xdc, 0x7c, 0x4e, 0x03, 0x08, 0xd8,
+        0xba, 0x54, 0x50, 0x44, 0xf7, 0x4a, 0x87, 0x1b,
+        0x45, 0x79, 0x7d, 0x7a, 0x1c, 0x8d, 0x07, 0xe8,
+        0x31, 0xde, 0xfa, 0x95, 0x82, 0x62, 0xd2, 0x56,
+        0x28, 0x5f, 0x34, 0xe6, 0xae, 0x8e, 0x2a, 0xaf,
+        0xc4, 0xa3, 0xc6, 0x0d, 0xb3, 0x56, 0x82, 0x97,
+        0x72, 0x65, 0x51, 0xd9, 0x8e, 0xcf, 0xe5, 0x45,
+        0x88, 0x10, 0x59, 0x4f, 0xdf, 0x81, 0x46, 0xb7,
+        0x78, 0x8e, 0x4f, 0x11, 0x5b, 0xeb, 0x8d, 0x2b,
+        0xbe, 0x5d, 0xeb, 0x07, 0x04, 0x24, 0x65, 0xf3
+    };
+#elif SPONGE_BLOCK_WORDS == 10
+    const uint8_t expected[SPONGE_STATE_SIZE_BYTES] = {
+        0x67, 0x4f, 0xb2, 0xb9, 0x2b, 0xc6, 0x62, 0x49,
+        0x75, 0x9a, 0xf1, 0xf7, 0x67, 0x50, 0xba, 0x4c,
+        0x54, 0x96, 0x28, 0xa5, 0x02, 0xa5, 0xcc, 0x8a,
+        0x6d, 0xbc, 0x1c, 0x9d, 0xd4, 0x5e, 0x57, 0x02,
+        0xce, 0x10, 0xa3, 0x55, 0x9d, 0xb0, 0x49, 0xa6,
+        0xa8, 0xcb, 0xbc, 0x58, 0x1c, 0x9a, 0xd6, 0x3e,
+        0x08, 0x8c, 0x77, 0x5e, 0x1d, 0x8c, 0xb2, 0xf4,
+        0x63, 0x7d, 0x24, 0x4e, 0xf0, 0x11, 0x43, 0x1b,
+        0xba, 0x51, 0x4f, 0xd3, 0xb2, 0x57, 0x7b, 0xeb,
+        0x64, 0x35, 0x0e, 0x92, 0xb2, 0x53, 0xd5, 0x34,
+        0x61, 0x80, 0x21, 0x2b, 0x73, 0x8f, 0xae, 0xf2,
+        0x3a, 0x1e, 0x6a, 0xf4, 0x43, 0x36, 0xec, 0xa5,
+        0xc5, 0x10, 0x19, 0xfb, 0x12, 0xb8, 0xf7, 0x9c,
+        0x70, 0xdb, 0xa7, 0x9a, 0xb1, 0x54, 0x8e, 0xcd,
+        0xe6, 0x65, 0x71, 0x5a, 0xed, 0x6f, 0x73, 0xb8,
+        0x73, 0x5d, 0x20, 0xfb, 0x58, 0xed, 0x7a, 0xde
+    };
+#else
     const uint8_t expected[SPONGE_STATE_SIZE_BYTES] = {
         0xfa, 0x08, 0x3d, 0x99, 0xf0, 0xef, 0xe6, 0xb2,
         0x9c, 0x52, 0x18, 0x59, 0xda, 0xcd, 0xb8, 0x4c,
@@ -285,15 +642,136 @@ START_TEST(reduced_extended_duplexing)
         0xa4, 0x36, 0x53, 0xd7, 0x83, 0x3c, 0x83, 0x21,
         0xaa, 0xa8, 0x8c, 0xcc, 0xdb, 0x09, 0x75, 0xfd
     };
+#endif
 
     sponge_t *sponge = sponge_new();
     memcpy(sponge->state, state, SPONGE_STATE_SIZE_BYTES);
-    sponge_reduced_extended_duplexing(sponge, (sponge_word_t *) data, (sponge_word_t *) duplexed);
+    sponge_reduced_extended_duplexing(sponge, (sponge_word_t *) data, (sponge_word_t *) duplexed, 0);
 
     ck_assert(!memcmp(sponge->state, expected, SPONGE_STATE_SIZE_BYTES));
     ck_assert(!memcmp(sponge->state, duplexed, SPONGE_EXTENDED_RATE_SIZE_BYTES));
     sponge_destroy(sponge);
     return;
+
+}
+END_TEST
+
+START_TEST(row_duplexing)
+{
+#line 595
+    // a row duplexing function must leave the sponge and the output blocks
+    // just like duplexing the blocks one at a time
+    enum { ncols = 5 };
+    ALIGN(SPONGE_MEM_ALIGNMENT) sponge_word_t in[ncols][SPONGE_EXTENDED_RATE_LENGTH];
+    ALIGN(SPONGE_MEM_ALIGNMENT) sponge_word_t out[ncols][SPONGE_EXTENDED_RATE_LENGTH];
+    ALIGN(SPONGE_MEM_ALIGNMENT) sponge_word_t expected[ncols][SPONGE_EXTENDED_RATE_LENGTH];
+
+    uint8_t *bytes = (uint8_t *) in;
+    for (unsigned int i = 0; i < sizeof(in); i++) {
+        bytes[i] = i * 7 + 3;
+    }
+
+    sponge_t *sponge = sponge_new(), *row = sponge_new();
+    for (unsigned int col = 0; col < ncols; col++) {
+        sponge_reduced_extended_duplexing(sponge, in[col], expected[col], 0);
+    }
+    duplex_row(row, ncols, in, out);
+
+    ck_assert(!memcmp(row->state, sponge->state, SPONGE_STATE_SIZE_BYTES));
+    ck_assert(!memcmp(out, expected, sizeof(out)));
+    sponge_destroy(sponge);
+    sponge_destroy(row);
+    return;
+
+}
+END_TEST
+
+START_TEST(x4_reduced_extended_duplexing)
+{
+#line 620
+    // each lane of the multi-buffer sponge must behave exactly like a
+    // regular sponge: duplex the first SPONGE_EXTENDED_RATE_SIZE_BYTES of
+    // data in lane 2 and in a regular sponge starting from the same state,
+    // and nothing in the other lanes, which start from the IV and so should
+    // match the sponge_compress_IV_reduced test.
+#ifdef HAVE_AVX2
+    const uint8_t state[SPONGE_STATE_SIZE_BYTES] = {
+        0xd7, 0x78, 0x76, 0xa0, 0x82, 0x2f, 0x53, 0x0a,
+        0x46, 0x41, 0xa4, 0xa3, 0x9e, 0xea, 0x15, 0xf2,
+        0xfb, 0xfb, 0x64, 0xf4, 0x4a, 0x79, 0x8b, 0xba,
+        0x03, 0xc4, 0x43, 0xa6, 0x5b, 0xe8, 0xad, 0x8c,
+        0x50, 0xb9, 0x97, 0x71, 0x99, 0x3c, 0x01, 0x36,
+        0x59, 0x31, 0x56, 0xbb, 0xef, 0x46, 0xfd, 0xd7,
+        0x01, 0x35, 0xae, 0xd2, 0x7a, 0x49, 0x36, 0xa4,
+        0x6b, 0x32, 0x6b, 0x95, 0x44, 0x57, 0x95, 0x70,
+        0x2b, 0x81, 0x9e, 0x1d, 0x0e, 0xfb, 0x65, 0xbe,
+        0x87, 0xc7, 0x14, 0xf1, 0x0d, 0x44, 0x38, 0xcc,
+        0xd7, 0x7d, 0xf2, 0xba, 0x78, 0x1f, 0x3b, 0xf3,
+        0x11, 0x33, 0x1c, 0x80, 0x96, 0xbf, 0x2f, 0xcc,
+        0xe4, 0xb0, 0xe2, 0x98, 0xf1, 0xc0, 0x28, 0xb6,
+        0xbb, 0x8f, 0x84, 0x61, 0xcb, 0xa9, 0xea, 0x20,
+        0x2e, 0xc2, 0x0e, 0x4e, 0x64, 0x6c, 0x6f, 0x79,
+        0xd4, 0x6f, 0xfc, 0xab, 0xf2, 0x67, 0xbd, 0x21
+    };
+
+    ALIGN(SPONGE_MEM_ALIGNMENT)
+    const uint8_t data[] = {
+        0xd5, 0x73, 0x5c, 0x93, 0x83, 0xf5, 0xd6, 0x2a,
+        0x31, 0x80, 0x41, 0x3d, 0xd9, 0x00, 0x00, 0x6f,
+        0x0a, 0x08, 0xfe, 0x35, 0x83, 0x84, 0xbc, 0xb2,
+        0x76, 0xbe, 0xdb, 0x7b, 0xf7, 0xbe, 0xcd, 0x04,
+        0x2a, 0x4b, 0x7f, 0x29, 0xdf, 0xd2, 0x9f, 0xe4,
+        0x9c, 0xbe, 0x80, 0x82, 0xe6, 0x52, 0xff, 0x87,
+        0xf1, 0x8d, 0xdb, 0x40, 0xff, 0x3f, 0x47, 0x53,
+        0x2c, 0x47, 0xc0, 0xd0, 0x6a, 0x95, 0x71, 0xa1,
+        0x5a, 0x29, 0x95, 0x10, 0x25, 0x74, 0x2b, 0x1e,
+        0x5e, 0x9d, 0xfb, 0xf0, 0x27, 0x26, 0xfd, 0x3b,
+        0x73, 0xd1, 0x0a, 0x8d, 0xa1, 0x6c, 0x6a, 0x62,
+        0x1f, 0x9e, 0x8a, 0x26, 0x34, 0x10, 0x06, 0x19
+    };
+
+    ALIGN(SPONGE_MEM_ALIGNMENT)
+    uint8_t blocks[SPONGE_X4_LANES][SPONGE_EXTENDED_RATE_SIZE_BYTES] = {{0}};
+    memcpy(blocks[2], data, SPONGE_EXTENDED_RATE_SIZE_BYTES);
+
+    sponge_word_t *lanes[SPONGE_X4_LANES];
+    for (unsigned int lane = 0; lane < SPONGE_X4_LANES; lane++) {
+        lanes[lane] = (sponge_word_t *) blocks[lane];
+    }
+
+    ALIGN(SPONGE_MEM_ALIGNMENT)
+    uint8_t duplexed[SPONGE_EXTENDED_RATE_SIZE_BYTES] = {0};
+
+    sponge_t *expected = sponge_new();
+    memcpy(expected->state, state, SPONGE_STATE_SIZE_BYTES);
+    sponge_reduced_extended_duplexing(expected, (sponge_word_t *) data, (sponge_word_t *) duplexed, 0);
+
+    sponge_t *sponge = sponge_new();
+    sponge_t *reduced_IV = sponge_new();
+    sponge_compress(reduced_IV, SPONGE_FLAG_REDUCED);
+
+    sponge_x4_t *sponge_x4 = sponge_x4_new();
+    memcpy(sponge->state, state, SPONGE_STATE_SIZE_BYTES);
+    sponge_x4_set_lane(sponge_x4, 2, sponge);
+    sponge_x4_reduced_extended_duplexing(sponge_x4, (const sponge_word_t **) lanes, lanes);
+
+    for (unsigned int lane = 0; lane < SPONGE_X4_LANES; lane++) {
+        sponge_x4_get_lane(sponge_x4, lane, sponge);
+        if (lane == 2) {
+            ck_assert(!memcmp(sponge->state, expected->state, SPONGE_STATE_SIZE_BYTES));
+        } else {
+            ck_assert(!memcmp(sponge->state, reduced_IV->state, SPONGE_STATE_SIZE_BYTES));
+        }
+
+        ck_assert(!memcmp(blocks[lane], sponge->state, SPONGE_EXTENDED_RATE_SIZE_BYTES));
+    }
+
+    sponge_x4_destroy(sponge_x4);
+    sponge_destroy(expected);
+    sponge_destroy(reduced_IV);
+    sponge_destroy(sponge);
+#endif
+    return;
 }
 END_TEST
 
@@ -303,9 +781,17 @@ int main(void)
 {
     tcase_add_test(tc1_1, sponge_compress_IV);
     tcase_add_test(tc1_1, sponge_compress_IV_reduced);
+    tcase_add_test(tc1_1, sponge_compress_IV_blamka);
+    tcase_add_test(tc1_1, sponge_compress_IV_reduced_blamka);
+    tcase_add_test(tc1_1, sponge_compress_rho);
     tcase_add_test(tc1_1, squeeze_IV);
     tcase_add_test(tc1_1, absorb_block_safe);
     tcase_add_test(tc1_1, absorb_block_extended);
+    tcase_add_test(tc1_1, absorb_streaming);
+    tcase_add_test(tc1_1, snapshot_and_clone);
+    tcase_add_test(tc1_1, reset);
     tcase_add_test(tc1_1, reduced_extended_duplexing);
+    tcase_add_test(tc1_1, row_duplexing);
+    tcase_add_test(tc1_1, x4_reduced_extended_duplexing);
     return 0;
 }